@@ -0,0 +1,882 @@
+/* -----------------------------------------------------------------------
+
+   Relayer emulating a bottleneck link between reliable senders and
+   receivers.
+
+   It reads the same config.xml as the prebuilt relayer.  For each pair
+   it listens on the sender's dst port and the receiver's dst port.
+   Datagrams from the sender go through the bottleneck and on to the
+   receiver; datagrams from the receiver go back to the sender after
+   the propagation delay only.
+
+   All pairs share one bottleneck of <bandwidth> kb/s with a queue of
+   <buffer_size> packets, as in the prebuilt relayer.  The queue is
+   drop-tail unless <aqm> asks for red or codel.
+
+   Threads:
+
+     - one per pair, receiving from both of its sockets;
+     - the link thread, which drains the queue through a token bucket
+       and sends packets once their propagation delay has passed;
+     - the log thread (only with <enable_log>1</enable_log>), which
+       formats the per-packet events the others leave in lock-free
+       rings, so logging never holds up a packet.
+
+   Time comes from CLOCK_MONOTONIC, so <CPU_frequency> is ignored, and
+   bandwidth is not capped.
+
+   Optional config elements, beyond those of the prebuilt relayer:
+
+     <aqm>none|red|codel</aqm>
+     <red_min>, <red_max>   average queue thresholds in packets
+                            (buffer_size/4 and 3*buffer_size/4)
+     <red_maxp>             drop probability at red_max (0.1)
+     <codel_target>         acceptable standing delay in ms (5)
+     <codel_interval>       ms the delay may exceed it (100)
+     <ecn_threshold>        mark packets that join a queue of this
+                            many packets or more (0, off)
+
+   Packets from ECN capable senders (PKT_ECT in the top byte of rwnd,
+   see rlib.h) are marked PKT_CE, with the checksum patched to match,
+   where RED or CoDel would drop them, and when they join a queue of
+   <ecn_threshold> packets or more, as a DCTCP switch marks.  A full
+   queue drops whatever the sender.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define NSEC_PER_MSEC	1000000ULL
+#define NSEC_PER_SEC	1000000000ULL
+#define MAX_PAIRS	64
+#define MAX_DGRAM	65536
+#define LOG_RING	8192		/* Events per thread, a power of two */
+
+/* Flags in the top byte of rwnd, as in rlib.h */
+#define PKT_ECT		0x80000000
+#define PKT_CE		0x40000000
+
+enum { AQM_NONE, AQM_RED, AQM_CODEL };
+
+struct pair_cfg {
+  char sender_src[256], sender_dst[256];
+  char receiver_src[256], receiver_dst[256];
+};
+
+struct config {
+  int npairs;
+  double delay_ms;
+  double bandwidth;		/* kb/s, 0 for unlimited */
+  int buffer;			/* Packets */
+  int enable_log;
+  int aqm;
+  double red_min, red_max, red_maxp;
+  double codel_target, codel_interval;	/* ms */
+  int ecn_threshold;		/* Packets, 0 for no threshold marking */
+  struct pair_cfg pair[MAX_PAIRS];
+};
+
+struct pkt {
+  struct pkt *next;
+  uint64_t t;			/* Arrival, then time it is due out */
+  int pair;
+  int len;
+  char data[];
+};
+
+/* FIFO of packets */
+struct pktq {
+  struct pkt *head, **tail;
+  int n;
+  size_t bytes;
+};
+
+/* Per-packet event for the log */
+struct logrec {
+  uint64_t t;
+  uint32_t seqno, ackno;
+  int32_t pair;
+  uint32_t qlen;
+  uint16_t len;
+  uint8_t ev;
+};
+
+enum { EV_DATA_IN, EV_ACK_IN, EV_QUEUE_DROP, EV_AQM_DROP, EV_LINK_OUT,
+       EV_DATA_OUT, EV_ACK_OUT, EV_MARK };
+static const char *ev_names[] = {
+  "data_in", "ack_in", "queue_drop", "aqm_drop", "link_out",
+  "data_out", "ack_out", "mark",
+};
+
+/* Single producer, single consumer ring of log events */
+struct logring {
+  struct logrec rec[LOG_RING];
+  uint32_t head;		/* Written by the producer */
+  uint32_t tail;		/* Written by the log thread */
+  uint64_t dropped;
+};
+
+struct pair {
+  int id;
+  int sfd;			/* Bound to sender dst, talks to the sender */
+  int rfd;			/* Bound to receiver dst, talks to the receiver */
+  struct sockaddr_storage sender, receiver;
+  socklen_t sender_len, receiver_len;
+  pthread_t thread;
+  struct logring log;
+
+  /* Counted by the pair thread */
+  uint64_t data_in, acks_in;
+  /* Counted under net.lock */
+  uint64_t queue_drops, aqm_drops, marks, data_out;
+};
+
+static struct config cfg;
+static struct pair pairs[MAX_PAIRS];
+static volatile sig_atomic_t stopping;
+
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t wake;		/* Something was queued */
+  pthread_t thread;
+  struct logring log;
+
+  struct pktq queue;		/* Waiting for the bottleneck */
+  struct pktq fwd, rev;		/* Propagating, in due order */
+  uint64_t rate;		/* Bytes per second, 0 for unlimited */
+  double tokens;		/* Bytes; negative while paying off a packet */
+  double depth;
+  uint64_t refilled;
+
+  /* RED */
+  double red_avg;
+  int red_count;
+  unsigned int seed;
+
+  /* CoDel, RFC 8289 */
+  uint64_t first_above, drop_next;
+  uint32_t count, lastcount;
+  int dropping;
+} net = { PTHREAD_MUTEX_INITIALIZER };
+
+static pthread_t log_thread;
+
+static uint64_t
+now_ns (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void
+pktq_init (struct pktq *q)
+{
+  q->head = NULL;
+  q->tail = &q->head;
+  q->n = 0;
+  q->bytes = 0;
+}
+
+static void
+pktq_push (struct pktq *q, struct pkt *p)
+{
+  p->next = NULL;
+  *q->tail = p;
+  q->tail = &p->next;
+  q->n++;
+  q->bytes += p->len;
+}
+
+static struct pkt *
+pktq_pop (struct pktq *q)
+{
+  struct pkt *p = q->head;
+  if (p) {
+    q->head = p->next;
+    if (!q->head)
+      q->tail = &q->head;
+    q->n--;
+    q->bytes -= p->len;
+  }
+  return p;
+}
+
+/* Logging */
+
+static void
+log_event (struct logring *r, int ev, int pair, const struct pkt *p,
+	   uint64_t t, int qlen)
+{
+  uint32_t head, tail;
+  struct logrec *rec;
+
+  if (!cfg.enable_log)
+    return;
+  head = __atomic_load_n (&r->head, __ATOMIC_RELAXED);
+  tail = __atomic_load_n (&r->tail, __ATOMIC_ACQUIRE);
+  if (head - tail == LOG_RING) {
+    r->dropped++;
+    return;
+  }
+  rec = &r->rec[head & (LOG_RING - 1)];
+  rec->t = t;
+  rec->ev = ev;
+  rec->pair = pair;
+  rec->len = p->len;
+  rec->qlen = qlen;
+  rec->ackno = rec->seqno = 0;
+  if (p->len >= 12)
+    rec->ackno = ntohl (*(uint32_t *) (p->data + 4));
+  if (p->len >= 16)
+    rec->seqno = ntohl (*(uint32_t *) (p->data + 12));
+  __atomic_store_n (&r->head, head + 1, __ATOMIC_RELEASE);
+}
+
+static int
+log_drain (struct logring *r, uint64_t t0)
+{
+  uint32_t head = __atomic_load_n (&r->head, __ATOMIC_ACQUIRE);
+  uint32_t tail = r->tail;
+  int n = 0;
+
+  for (; tail != head; tail++, n++) {
+    const struct logrec *rec = &r->rec[tail & (LOG_RING - 1)];
+    printf ("%.6f pair %d %s len %u seqno %u ackno %u qlen %u\n",
+	    (rec->t - t0) / 1e9, rec->pair + 1, ev_names[rec->ev], rec->len,
+	    rec->seqno, rec->ackno, rec->qlen);
+  }
+  __atomic_store_n (&r->tail, tail, __ATOMIC_RELEASE);
+  return n;
+}
+
+static void *
+log_main (void *arg)
+{
+  uint64_t t0 = *(uint64_t *) arg;
+  struct timespec pause = { 0, 10 * NSEC_PER_MSEC };
+  int i, n;
+
+  do {
+    n = log_drain (&net.log, t0);
+    for (i = 0; i < cfg.npairs; i++)
+      n += log_drain (&pairs[i].log, t0);
+    if (n)
+      fflush (stdout);
+    else
+      nanosleep (&pause, NULL);
+  } while (!stopping || n);
+  return NULL;
+}
+
+/* Queue management, all called with net.lock held */
+
+/* Sets PKT_CE in p if its sender is ECN capable, patching the checksum
+ * incrementally (RFC 1624).  Returns 0 if p cannot be marked. */
+static int
+ecn_mark (struct logring *log, struct pkt *p)
+{
+  uint16_t cksum, old, new;
+  uint32_t rwnd, sum;
+
+  if (p->len <= 12)
+    return 0;
+  memcpy (&rwnd, p->data + 8, 4);
+  if (!(ntohl (rwnd) & PKT_ECT))
+    return 0;
+  if (!(ntohl (rwnd) & PKT_CE)) {
+    memcpy (&cksum, p->data, 2);
+    memcpy (&old, p->data + 8, 2);
+    old = ntohs (old);
+    new = old | (PKT_CE >> 16);
+    sum = (uint16_t) ~ntohs (cksum) + (uint16_t) ~old + new;
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (uint16_t) ~sum;
+    cksum = htons (sum ? sum : 0xffff);
+    new = htons (new);
+    memcpy (p->data, &cksum, 2);
+    memcpy (p->data + 8, &new, 2);
+  }
+  pairs[p->pair].marks++;
+  log_event (log, EV_MARK, p->pair, p, p->t, net.queue.n);
+  return 1;
+}
+
+static int
+red_admit (void)
+{
+  double p;
+
+  net.red_avg += 0.002 * (net.queue.n - net.red_avg);
+  if (net.red_avg < cfg.red_min) {
+    net.red_count = -1;
+    return 1;
+  }
+  if (net.red_avg >= cfg.red_max) {
+    net.red_count = 0;
+    return 0;
+  }
+  net.red_count++;
+  p = cfg.red_maxp * (net.red_avg - cfg.red_min) / (cfg.red_max - cfg.red_min);
+  /* Spread drops out evenly rather than in clumps */
+  if (net.red_count * p < 1)
+    p /= 1 - net.red_count * p;
+  else
+    p = 1;
+  if ((double) rand_r (&net.seed) / RAND_MAX < p) {
+    net.red_count = 0;
+    return 0;
+  }
+  return 1;
+}
+
+static void
+aqm_drop (struct pkt *p, uint64_t t)
+{
+  pairs[p->pair].aqm_drops++;
+  log_event (&net.log, EV_AQM_DROP, p->pair, p, t, net.queue.n);
+  free (p);
+}
+
+/* CoDel's dodequeue: the head packet, and whether it may be dropped */
+static struct pkt *
+codel_head (uint64_t t, int *ok_to_drop)
+{
+  struct pkt *p = pktq_pop (&net.queue);
+  uint64_t target = cfg.codel_target * NSEC_PER_MSEC;
+
+  *ok_to_drop = 0;
+  if (!p) {
+    net.first_above = 0;
+    return NULL;
+  }
+  if (t - p->t < target || net.queue.bytes <= 1500)
+    net.first_above = 0;
+  else if (!net.first_above)
+    net.first_above = t + cfg.codel_interval * NSEC_PER_MSEC;
+  else if (t >= net.first_above)
+    *ok_to_drop = 1;
+  return p;
+}
+
+static uint64_t
+codel_next (uint64_t t)
+{
+  return t + cfg.codel_interval * NSEC_PER_MSEC / sqrt (net.count);
+}
+
+static struct pkt *
+codel_dequeue (uint64_t t)
+{
+  int ok_to_drop;
+  struct pkt *p = codel_head (t, &ok_to_drop);
+
+  if (net.dropping) {
+    if (!ok_to_drop)
+      net.dropping = 0;
+    while (net.dropping && t >= net.drop_next) {
+      net.count++;
+      if (ecn_mark (&net.log, p)) {
+	net.drop_next = codel_next (net.drop_next);
+	break;
+      }
+      aqm_drop (p, t);
+      p = codel_head (t, &ok_to_drop);
+      if (!ok_to_drop)
+	net.dropping = 0;
+      else
+	net.drop_next = codel_next (net.drop_next);
+    }
+  }
+  else if (ok_to_drop) {
+    uint32_t delta;
+    if (!ecn_mark (&net.log, p)) {
+      aqm_drop (p, t);
+      p = codel_head (t, &ok_to_drop);
+    }
+    net.dropping = 1;
+    delta = net.count - net.lastcount;
+    net.count = 1;
+    if (delta > 1 && t - net.drop_next < 16 * cfg.codel_interval * NSEC_PER_MSEC)
+      net.count = delta;
+    net.drop_next = codel_next (t);
+    net.lastcount = net.count;
+  }
+  return p;
+}
+
+/* Threads */
+
+static void
+link_enqueue (struct pkt *p)
+{
+  struct pair *pr = &pairs[p->pair];
+  int marked;
+
+  pthread_mutex_lock (&net.lock);
+  /* The queue length is the link thread's, so it is read here */
+  log_event (&pr->log, EV_DATA_IN, pr->id, p, p->t, net.queue.n);
+  if (net.queue.n >= cfg.buffer) {
+    pr->queue_drops++;
+    log_event (&pr->log, EV_QUEUE_DROP, p->pair, p, p->t, net.queue.n);
+    pthread_mutex_unlock (&net.lock);
+    free (p);
+    return;
+  }
+  /* RED marks where it would drop, if the sender lets it */
+  marked = 0;
+  if (cfg.aqm == AQM_RED && !red_admit ()
+      && !(marked = ecn_mark (&pr->log, p))) {
+    pr->aqm_drops++;
+    log_event (&pr->log, EV_AQM_DROP, p->pair, p, p->t, net.queue.n);
+    pthread_mutex_unlock (&net.lock);
+    free (p);
+    return;
+  }
+  if (!marked && cfg.ecn_threshold && net.queue.n >= cfg.ecn_threshold)
+    ecn_mark (&pr->log, p);
+  pktq_push (&net.queue, p);
+  if (net.queue.n == 1)
+    pthread_cond_signal (&net.wake);
+  pthread_mutex_unlock (&net.lock);
+}
+
+static void
+link_reverse (struct pkt *p)
+{
+  p->t += cfg.delay_ms * NSEC_PER_MSEC;
+  pthread_mutex_lock (&net.lock);
+  pktq_push (&net.rev, p);
+  if (net.rev.n == 1)
+    pthread_cond_signal (&net.wake);
+  pthread_mutex_unlock (&net.lock);
+}
+
+static void *
+pair_main (void *arg)
+{
+  struct pair *pr = arg;
+  struct pollfd pfd[2];
+  static __thread char buf[MAX_DGRAM];
+  int i, n;
+
+  pfd[0].fd = pr->sfd;
+  pfd[1].fd = pr->rfd;
+  pfd[0].events = pfd[1].events = POLLIN;
+
+  while (!stopping) {
+    if (poll (pfd, 2, 100) <= 0)
+      continue;
+    for (i = 0; i < 2; i++) {
+      struct pkt *p;
+      if (!(pfd[i].revents & POLLIN))
+	continue;
+      n = recv (pfd[i].fd, buf, sizeof (buf), 0);
+      if (n < 0) {
+	/* ICMP errors from a side that is not up yet */
+	if (errno != ECONNREFUSED && errno != EAGAIN)
+	  fprintf (stderr, "ERROR: pair %d, in reading UDP socket: %s\n",
+		   pr->id + 1, strerror (errno));
+	continue;
+      }
+      p = malloc (sizeof (*p) + n);
+      if (!p) {
+	fprintf (stderr, "ERROR: out of memory\n");
+	exit (1);
+      }
+      memcpy (p->data, buf, n);
+      p->len = n;
+      p->pair = pr->id;
+      p->t = now_ns ();
+      if (i == 0) {
+	pr->data_in++;
+	link_enqueue (p);
+      }
+      else {
+	pr->acks_in++;
+	log_event (&pr->log, EV_ACK_IN, pr->id, p, p->t, 0);
+	link_reverse (p);
+      }
+    }
+  }
+  return NULL;
+}
+
+static void
+refill (uint64_t t)
+{
+  if (!net.rate)
+    return;
+  net.tokens += (double) (t - net.refilled) * net.rate / NSEC_PER_SEC;
+  if (net.tokens > net.depth)
+    net.tokens = net.depth;
+  net.refilled = t;
+}
+
+static void
+send_due (struct pktq *q, uint64_t t, int to_receiver)
+{
+  struct pktq out;
+  struct pkt *p;
+
+  pktq_init (&out);
+  while (q->head && q->head->t <= t)
+    pktq_push (&out, pktq_pop (q));
+  if (!out.head)
+    return;
+
+  /* Send without the lock so the pair threads can keep queueing */
+  pthread_mutex_unlock (&net.lock);
+  while ((p = pktq_pop (&out))) {
+    struct pair *pr = &pairs[p->pair];
+    int n;
+    if (to_receiver)
+      n = sendto (pr->rfd, p->data, p->len, 0,
+		  (struct sockaddr *) &pr->receiver, pr->receiver_len);
+    else
+      n = sendto (pr->sfd, p->data, p->len, 0,
+		  (struct sockaddr *) &pr->sender, pr->sender_len);
+    if (n < 0 && errno != ECONNREFUSED)
+      fprintf (stderr, "ERROR: pair %d, in relay %s packets: %s\n",
+	       p->pair + 1, to_receiver ? "UDP" : "ACK", strerror (errno));
+    log_event (&net.log, to_receiver ? EV_DATA_OUT : EV_ACK_OUT, p->pair,
+	       p, t, 0);
+    free (p);
+  }
+  pthread_mutex_lock (&net.lock);
+}
+
+static void *
+link_main (void *arg)
+{
+  uint64_t delay = cfg.delay_ms * NSEC_PER_MSEC;
+
+  pthread_mutex_lock (&net.lock);
+  net.refilled = now_ns ();
+  net.tokens = net.depth;
+  while (!stopping) {
+    uint64_t t = now_ns (), next = UINT64_MAX;
+    struct pkt *p;
+
+    /* Serialize onto the link while the bucket has tokens */
+    refill (t);
+    while (net.queue.head && (!net.rate || net.tokens >= 0)) {
+      p = cfg.aqm == AQM_CODEL ? codel_dequeue (t) : pktq_pop (&net.queue);
+      if (!p)
+	break;
+      if (net.rate)
+	net.tokens -= p->len;
+      pairs[p->pair].data_out++;
+      log_event (&net.log, EV_LINK_OUT, p->pair, p, t, net.queue.n);
+      p->t = t + delay;
+      pktq_push (&net.fwd, p);
+    }
+    send_due (&net.fwd, t, 1);
+    send_due (&net.rev, t, 0);
+
+    if (net.queue.head)
+      next = t + (net.tokens < 0 ? -net.tokens * NSEC_PER_SEC / net.rate : 0);
+    if (net.fwd.head && net.fwd.head->t < next)
+      next = net.fwd.head->t;
+    if (net.rev.head && net.rev.head->t < next)
+      next = net.rev.head->t;
+
+    t = now_ns ();
+    if (next <= t)
+      continue;
+    if (next == UINT64_MAX)
+      next = t + 100 * NSEC_PER_MSEC;	/* to notice stopping */
+    {
+      struct timespec ts = { next / NSEC_PER_SEC, next % NSEC_PER_SEC };
+      pthread_cond_timedwait (&net.wake, &net.lock, &ts);
+    }
+  }
+  pthread_mutex_unlock (&net.lock);
+  return NULL;
+}
+
+/* Configuration */
+
+/* Text of the first <tag> between from and end, in out */
+static int
+tag_text (const char *from, const char *end, const char *tag,
+	  char *out, size_t n)
+{
+  char open[64], close[64];
+  const char *a, *b;
+  size_t len;
+
+  snprintf (open, sizeof (open), "<%s>", tag);
+  snprintf (close, sizeof (close), "</%s>", tag);
+  a = strstr (from, open);
+  if (!a || a >= end)
+    return -1;
+  a += strlen (open);
+  b = strstr (a, close);
+  if (!b || b > end)
+    return -1;
+  while (a < b && strchr (" \t\r\n", *a))
+    a++;
+  while (b > a && strchr (" \t\r\n", b[-1]))
+    b--;
+  len = b - a < n - 1 ? b - a : n - 1;
+  memcpy (out, a, len);
+  out[len] = '\0';
+  return 0;
+}
+
+static double
+tag_num (const char *doc, const char *tag, double dflt, int required)
+{
+  char v[64];
+  if (tag_text (doc, doc + strlen (doc), tag, v, sizeof (v)) < 0) {
+    if (required) {
+      fprintf (stderr, "ERROR: %s is incorrect\n", tag);
+      exit (1);
+    }
+    return dflt;
+  }
+  return atof (v);
+}
+
+static void
+read_config (const char *path)
+{
+  FILE *f = fopen (path, "r");
+  char *doc, *c, *e, *pos, *pend;
+  char v[64];
+  long n;
+  int i;
+
+  if (!f) {
+    fprintf (stderr, "ERROR: %s: %s\n", path, strerror (errno));
+    exit (1);
+  }
+  fseek (f, 0, SEEK_END);
+  n = ftell (f);
+  rewind (f);
+  doc = malloc (n + 1);
+  if (!doc || fread (doc, 1, n, f) != n) {
+    fprintf (stderr, "ERROR: reading %s\n", path);
+    exit (1);
+  }
+  doc[n] = '\0';
+  fclose (f);
+
+  /* Blank out comments, which hold example pairs */
+  for (c = doc; (c = strstr (c, "<!--")); c = e) {
+    e = strstr (c, "-->");
+    e = e ? e + 3 : doc + n;
+    memset (c, ' ', e - c);
+  }
+
+  cfg.npairs = tag_num (doc, "number_of_pairs", 0, 1);
+  cfg.delay_ms = tag_num (doc, "propagation_delay", 0, 1);
+  cfg.bandwidth = tag_num (doc, "bandwidth", 0, 1);
+  cfg.buffer = tag_num (doc, "buffer_size", 0, 1);
+  cfg.enable_log = tag_num (doc, "enable_log", 0, 0);
+  cfg.red_min = tag_num (doc, "red_min", cfg.buffer / 4.0, 0);
+  cfg.red_max = tag_num (doc, "red_max", cfg.buffer * 3 / 4.0, 0);
+  cfg.red_maxp = tag_num (doc, "red_maxp", 0.1, 0);
+  cfg.codel_target = tag_num (doc, "codel_target", 5, 0);
+  cfg.codel_interval = tag_num (doc, "codel_interval", 100, 0);
+  cfg.ecn_threshold = tag_num (doc, "ecn_threshold", 0, 0);
+
+  cfg.aqm = AQM_NONE;
+  if (tag_text (doc, doc + n, "aqm", v, sizeof (v)) == 0) {
+    if (!strcmp (v, "red"))
+      cfg.aqm = AQM_RED;
+    else if (!strcmp (v, "codel"))
+      cfg.aqm = AQM_CODEL;
+    else if (strcmp (v, "none")) {
+      fprintf (stderr, "ERROR: aqm is incorrect\n");
+      exit (1);
+    }
+  }
+
+  if (cfg.npairs < 1 || cfg.npairs > MAX_PAIRS) {
+    fprintf (stderr, "ERROR: number_of_pairs is incorrect\n");
+    exit (1);
+  }
+  if (cfg.buffer < 1) {
+    fprintf (stderr, "ERROR: buffer_size is incorrect\n");
+    exit (1);
+  }
+
+  pos = doc;
+  for (i = 0; i < cfg.npairs; i++) {
+    struct pair_cfg *pc = &cfg.pair[i];
+    char *s, *se, *r, *re;
+    pos = strstr (pos, "<pair>");
+    pend = pos ? strstr (pos, "</pair>") : NULL;
+    s = pos ? strstr (pos, "<sender>") : NULL;
+    se = s ? strstr (s, "</sender>") : NULL;
+    r = pos ? strstr (pos, "<receiver>") : NULL;
+    re = r ? strstr (r, "</receiver>") : NULL;
+    if (!pend || !se || !re || se > pend || re > pend
+	|| tag_text (s, se, "src", pc->sender_src, sizeof (pc->sender_src))
+	|| tag_text (s, se, "dst", pc->sender_dst, sizeof (pc->sender_dst))
+	|| tag_text (r, re, "src", pc->receiver_src, sizeof (pc->receiver_src))
+	|| tag_text (r, re, "dst", pc->receiver_dst, sizeof (pc->receiver_dst))) {
+      fprintf (stderr, "ERROR: pair %d is incorrect\n", i + 1);
+      exit (1);
+    }
+    pos = pend;
+  }
+  free (doc);
+}
+
+/* Resolve "host:port" */
+static int
+resolve (const char *name, struct sockaddr_storage *ss, socklen_t *len,
+	 int pair, const char *what)
+{
+  char host[256];
+  const char *colon = strrchr (name, ':');
+  struct addrinfo hints, *ai;
+  int err;
+
+  if (!colon || colon - name >= sizeof (host)) {
+    fprintf (stderr, "ERROR: pair %d, %s, %s:unknown host\n", pair, what, name);
+    return -1;
+  }
+  memcpy (host, name, colon - name);
+  host[colon - name] = '\0';
+  memset (&hints, 0, sizeof (hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  if ((err = getaddrinfo (host, colon + 1, &hints, &ai))) {
+    fprintf (stderr, "ERROR: pair %d, %s, %s:unknown host\n", pair, what, name);
+    return -1;
+  }
+  memcpy (ss, ai->ai_addr, ai->ai_addrlen);
+  *len = ai->ai_addrlen;
+  freeaddrinfo (ai);
+  return 0;
+}
+
+static int
+bind_port (const char *name, int pair)
+{
+  struct sockaddr_in sin;
+  const char *colon = strrchr (name, ':');
+  int fd, buf = 4 << 20;
+
+  fd = socket (AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    fprintf (stderr, "ERROR: opening stream socket pair %d, %s!\n",
+	     pair, strerror (errno));
+    return -1;
+  }
+  /* Room for bursts at hundreds of Mb/s */
+  setsockopt (fd, SOL_SOCKET, SO_RCVBUF, &buf, sizeof (buf));
+  setsockopt (fd, SOL_SOCKET, SO_SNDBUF, &buf, sizeof (buf));
+  memset (&sin, 0, sizeof (sin));
+  sin.sin_family = AF_INET;
+  sin.sin_port = htons (atoi (colon ? colon + 1 : name));
+  sin.sin_addr.s_addr = htonl (INADDR_ANY);
+  if (bind (fd, (struct sockaddr *) &sin, sizeof (sin)) < 0) {
+    fprintf (stderr, "ERROR: UDP Binding error, pair %d, %s!\n",
+	     pair, strerror (errno));
+    close (fd);
+    return -1;
+  }
+  return fd;
+}
+
+int
+main (int argc, char **argv)
+{
+  static const char *aqm_names[] = { "none", "red", "codel" };
+  pthread_condattr_t ca;
+  sigset_t sigs;
+  uint64_t t0;
+  int i, sig;
+
+  if (argc != 2) {
+    fprintf (stderr, "usage: %s config.xml\n", argv[0]);
+    exit (1);
+  }
+  read_config (argv[1]);
+
+  for (i = 0; i < cfg.npairs; i++) {
+    struct pair *pr = &pairs[i];
+    struct pair_cfg *pc = &cfg.pair[i];
+    pr->id = i;
+    if (resolve (pc->sender_src, &pr->sender, &pr->sender_len, i + 1, "sender") < 0
+	|| resolve (pc->receiver_src, &pr->receiver, &pr->receiver_len, i + 1,
+		    "receiver") < 0
+	|| (pr->sfd = bind_port (pc->sender_dst, i + 1)) < 0
+	|| (pr->rfd = bind_port (pc->receiver_dst, i + 1)) < 0) {
+      fprintf (stderr, "ERROR: UDP Socket establish failure for pair %d!\n", i + 1);
+      exit (1);
+    }
+  }
+
+  pktq_init (&net.queue);
+  pktq_init (&net.fwd);
+  pktq_init (&net.rev);
+  net.rate = cfg.bandwidth * 1000 / 8;
+  /* Bursts of up to a millisecond, so the link keeps pace when the
+   * link thread wakes late, but at least a couple of full packets */
+  net.depth = net.rate / 1000.0 > 3000 ? net.rate / 1000.0 : 3000;
+  net.seed = getpid ();
+  pthread_condattr_init (&ca);
+  pthread_condattr_setclock (&ca, CLOCK_MONOTONIC);
+  pthread_cond_init (&net.wake, &ca);
+
+  /* Only main sees SIGINT and SIGTERM */
+  sigemptyset (&sigs);
+  sigaddset (&sigs, SIGINT);
+  sigaddset (&sigs, SIGTERM);
+  pthread_sigmask (SIG_BLOCK, &sigs, NULL);
+
+  fprintf (stderr, "rrelay: %d pairs, %g kb/s, %g ms, buffer %d packets, aqm %s\n",
+	   cfg.npairs, cfg.bandwidth, cfg.delay_ms, cfg.buffer, aqm_names[cfg.aqm]);
+
+  t0 = now_ns ();
+  if (cfg.enable_log)
+    pthread_create (&log_thread, NULL, log_main, &t0);
+  pthread_create (&net.thread, NULL, link_main, NULL);
+  for (i = 0; i < cfg.npairs; i++)
+    pthread_create (&pairs[i].thread, NULL, pair_main, &pairs[i]);
+
+  sigwait (&sigs, &sig);
+  stopping = 1;
+  pthread_mutex_lock (&net.lock);
+  pthread_cond_signal (&net.wake);
+  pthread_mutex_unlock (&net.lock);
+  for (i = 0; i < cfg.npairs; i++)
+    pthread_join (pairs[i].thread, NULL);
+  pthread_join (net.thread, NULL);
+  if (cfg.enable_log)
+    pthread_join (log_thread, NULL);
+
+  for (i = 0; i < cfg.npairs; i++) {
+    struct pair *pr = &pairs[i];
+    fprintf (stderr, "pair %d: data in %llu out %llu, queue drops %llu,"
+	     " aqm drops %llu, marks %llu, acks %llu, log drops %llu\n", i + 1,
+	     (unsigned long long) pr->data_in, (unsigned long long) pr->data_out,
+	     (unsigned long long) pr->queue_drops,
+	     (unsigned long long) pr->aqm_drops,
+	     (unsigned long long) pr->marks,
+	     (unsigned long long) pr->acks_in,
+	     (unsigned long long) pr->log.dropped);
+  }
+  return 0;
+}
@@ -0,0 +1,101 @@
+#!/bin/bash
+#
+# End-to-end throughput benchmark: sends a generated file from
+# "reliable -s" to "reliable -r" through the 3b relayer and appends one
+# CSV line per run:
+#
+#   date,label,config,size,run,ok,completion_ms,goodput_kbps,
+#   retrans_ratio,sender_cpu_s,receiver_cpu_s
+#
+# completion_ms is the sender's wall time, goodput counts file bytes
+# only, and retrans_ratio is retransmitted over total data packets from
+# the sender's -S statistics.
+#
+# Settings come from the environment (make bench passes them through):
+#
+#   RELIABLE   binary to test (./reliable)
+#   RELAYER    relayer binary (../relayer/relayer)
+#   CONFIG     relayer config; only its first pair is used
+#              (../relayer/config.xml)
+#   SIZE       input size in bytes (1000000)
+#   RUNS       runs per invocation (3)
+#   WINDOW     -w given to both ends (32)
+#   LABEL      name for this build in the CSV (git describe)
+#   OUT        CSV file to append to (bench/results.csv)
+#   BASELINE   CSV to compare against; rows with the same config and
+#              size are averaged (unset: no comparison)
+#   TOLERANCE  allowed goodput drop against BASELINE, percent (10)
+#   TIMEOUT    seconds before a run is given up on (120)
+#
+# Exits non-zero if a run fails to reproduce its input or goodput drops
+# below the baseline by more than TOLERANCE.
+
+cd "$(dirname "$0")/.." || exit 1
+
+RELIABLE=${RELIABLE:-./reliable}
+RELAYER=${RELAYER:-../relayer/relayer}
+CONFIG=${CONFIG:-../relayer/config.xml}
+SIZE=${SIZE:-1000000}
+RUNS=${RUNS:-3}
+WINDOW=${WINDOW:-32}
+LABEL=${LABEL:-$(git describe --always --dirty 2>/dev/null || echo unknown)}
+OUT=${OUT:-bench/results.csv}
+TOLERANCE=${TOLERANCE:-10}
+TIMEOUT=${TIMEOUT:-120}
+RELIABLE_OPTS="-w $WINDOW $RELIABLE_OPTS"
+
+. bench/common.sh
+
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/bench.XXXXXX")
+trap 'relayer_stop; [ -n "$KEEP" ] || rm -rf "$WORK"' EXIT
+
+cp "$CONFIG" "$WORK/config.xml"
+cfg_set "$WORK/config.xml" "$WORK/config.xml" number_of_pairs 1
+cfg_fix_cpu "$WORK/config.xml"
+
+head -c "$SIZE" /dev/urandom > "$WORK/input"
+
+if [ ! -s "$OUT" ]; then
+	echo "date,label,config,size,run,ok,completion_ms,goodput_kbps,retrans_ratio,sender_cpu_s,receiver_cpu_s" > "$OUT"
+fi
+
+status=0
+sum=0
+for run in $(seq 1 "$RUNS"); do
+	relayer_start "$WORK/config.xml" || exit 1
+	run_pair "$WORK/config.xml" 1 "$WORK/input"
+	relayer_stop
+
+	ok=1
+	cmp -s "$WORK/input" "$WORK/out.1" || { ok=0; status=1; }
+	ms=$(cat "$WORK/wall.1")
+	goodput=$(awk -v b="$SIZE" -v ms="$ms" 'BEGIN { printf "%.1f", (ms > 0 ? b * 8 / ms : 0) }')
+	sent=$(json_num "$WORK/stats.1" sender pkts_sent)
+	retx=$(json_num "$WORK/stats.1" sender retransmits)
+	ratio=$(awk -v s="${sent:-0}" -v r="${retx:-0}" 'BEGIN { printf "%.4f", (s > 0 ? r / s : 0) }')
+	scpu=$(cpu_sum "$WORK/cpu.1.sender")
+	rcpu=$(cpu_sum "$WORK/cpu.1.receiver")
+
+	echo "$(date +%Y-%m-%dT%H:%M:%S),$LABEL,$(basename "$CONFIG"),$SIZE,$run,$ok,$ms,$goodput,$ratio,$scpu,$rcpu" >> "$OUT"
+	printf "run %d: %s, %d ms, %s kb/s, retransmit ratio %s, cpu %ss/%ss\n" \
+		"$run" "$([ $ok = 1 ] && echo ok || echo CORRUPT)" "$ms" "$goodput" "$ratio" "$scpu" "$rcpu"
+	sum=$(awk -v a="$sum" -v b="$goodput" 'BEGIN { print a + b }')
+done
+
+mean=$(awk -v s="$sum" -v n="$RUNS" 'BEGIN { printf "%.1f", s / n }')
+echo "mean goodput $mean kb/s ($LABEL, results in $OUT)"
+
+if [ -n "$BASELINE" ]; then
+	base=$(awk -F, -v cfg="$(basename "$CONFIG")" -v size="$SIZE" '
+		NR > 1 && $3 == cfg && $4 == size && $6 == 1 { s += $8; n++ }
+		END { if (n) printf "%.1f", s / n }' "$BASELINE")
+	if [ -z "$base" ]; then
+		echo "no baseline rows for $(basename "$CONFIG") size $SIZE in $BASELINE"
+	else
+		verdict=$(awk -v m="$mean" -v b="$base" -v t="$TOLERANCE" '
+			BEGIN { d = (m - b) * 100 / b; printf "%+.1f%% %s", d, (d < -t ? "REGRESSION" : "ok") }')
+		echo "baseline $base kb/s: $verdict"
+		case "$verdict" in *REGRESSION) status=1 ;; esac
+	fi
+fi
+exit $status
@@ -0,0 +1,136 @@
+# Helpers shared by the benchmark scripts.  Source this file; it expects
+# RELIABLE, RELAYER and WORK to be set.
+
+# Value of a top-level element of a relayer config, e.g. cfg_get f bandwidth
+cfg_get () {
+	sed -n "s:.*<$2>[[:space:]]*\([^<]*\)[[:space:]]*</$2>.*:\1:p" "$1" | head -n 1
+}
+
+# Copy config $1 to $2 with element $3 set to $4.
+cfg_set () {
+	sed "s:<$3>[^<]*</$3>:<$3>$4</$3>:" "$1" > "$2.tmp" && mv "$2.tmp" "$2"
+}
+
+# Address of field $3 (src or dst) of the $2 (sender or receiver) side
+# of pair number $4 (from 1) in config $1.
+cfg_pair () {
+	awk -v side="$2" -v field="$3" -v want="$4" '
+		/<!--/ { comment = 1 }
+		/-->/ { comment = 0; next }
+		comment { next }
+		/<pair>/ { n++ }
+		n == want && index($0, "<" side ">") { inside = 1 }
+		n == want && index($0, "</" side ">") { inside = 0 }
+		inside && index($0, "<" field ">") {
+			sub(".*<" field ">[[:space:]]*", ""); sub("[[:space:]]*</" field ">.*", "")
+			print; exit
+		}' "$1"
+}
+
+# The relayer paces packets with the TSC and needs the real clock rate.
+cfg_fix_cpu () {
+	mhz=$(awk -F: '/^cpu MHz/ { gsub(/ /, "", $2); print $2; exit }' /proc/cpuinfo 2>/dev/null)
+	if [ -n "$mhz" ]; then
+		cfg_set "$1" "$1" CPU_frequency "$mhz"
+	fi
+}
+
+# Number from a one-line JSON stats record: json_num file role key
+json_num () {
+	grep "\"role\":\"$2\"" "$1" | tail -n 1 | sed -n "s/.*\"$3\":\([-0-9.e]*\).*/\1/p"
+}
+
+# Start the relayer on config $1, logging to $WORK/relayer.log.
+relayer_start () {
+	"$RELAYER" "$1" > "$WORK/relayer.log" 2>&1 &
+	RELAYER_PID=$!
+	sleep 0.5
+	if ! kill -0 $RELAYER_PID 2>/dev/null || grep -q ERROR "$WORK/relayer.log"; then
+		relayer_stop
+		echo "relayer failed to start:" >&2
+		cat "$WORK/relayer.log" >&2
+		return 1
+	fi
+}
+
+relayer_stop () {
+	kill $RELAYER_PID 2>/dev/null
+	wait $RELAYER_PID 2>/dev/null
+}
+
+# port of host:port
+port_of () {
+	echo "${1##*:}"
+}
+
+# Run pair $2 of config $1, sending file $3.  Output goes to
+# $WORK/out.$2, stats to $WORK/stats.$2, CPU seconds to $WORK/cpu.$2.*
+# and wall milliseconds to $WORK/wall.$2.  Extra reliable options come
+# from $RELIABLE_OPTS.  Returns once both ends have exited.
+run_pair () {
+	local cfg=$1 pair=$2 input=$3
+	local s_src s_dst r_src r_dst
+	s_src=$(cfg_pair "$cfg" sender src "$pair")
+	s_dst=$(cfg_pair "$cfg" sender dst "$pair")
+	r_src=$(cfg_pair "$cfg" receiver src "$pair")
+	r_dst=$(cfg_pair "$cfg" receiver dst "$pair")
+	rm -f "$WORK/out.$pair" "$WORK/stats.$pair"
+
+	TIMEFORMAT='%U %S'
+	( { time timeout "$TIMEOUT" "$RELIABLE" $RELIABLE_OPTS -S "$WORK/stats.$pair" \
+		-r "$WORK/out.$pair" "$(port_of "$r_src")" "$r_dst" \
+		2> "$WORK/receiver.$pair.log" ; } 2> "$WORK/cpu.$pair.receiver" ) &
+	local rpid=$!
+	sleep 0.2
+	local t0 t1
+	t0=$(date +%s%N)
+	{ time timeout "$TIMEOUT" "$RELIABLE" $RELIABLE_OPTS -S "$WORK/stats.$pair" \
+		-s "$input" "$(port_of "$s_src")" "$s_dst" \
+		2> "$WORK/sender.$pair.log" ; } 2> "$WORK/cpu.$pair.sender"
+	t1=$(date +%s%N)
+	echo $(( (t1 - t0) / 1000000 )) > "$WORK/wall.$pair"
+	wait $rpid
+}
+
+# Sum of the user and system seconds in a bash time report.
+cpu_sum () {
+	awk '{ print $1 + $2 }' "$1" 2>/dev/null
+}
+
+# Rewrite the <pairs> of config $1 as $2 localhost pairs and set
+# number_of_pairs to match.  Pair i sends from port 11000+i to relayer
+# port 51000+2i and receives on 21000+i from relayer port 51001+2i.
+cfg_write_pairs () {
+	awk -v n="$2" '
+		/<pairs>/ {
+			print "\t<pairs>"
+			for (i = 1; i <= n; i++) {
+				print "  <pair>"
+				print "   <sender>"
+				printf "\t   <src>localhost:%d</src>\n", 11000 + i
+				printf "\t   <dst>localhost:%d</dst>\n", 51000 + 2 * i
+				print "   </sender>"
+				print "   <receiver>"
+				printf "\t   <src>localhost:%d</src>\n", 21000 + i
+				printf "\t   <dst>localhost:%d</dst>\n", 51001 + 2 * i
+				print "   </receiver>"
+				print "  </pair>"
+			}
+			skip = 1
+			next
+		}
+		/<\/pairs>/ { skip = 0 }
+		!skip' "$1" > "$1.tmp" && mv "$1.tmp" "$1"
+	cfg_set "$1" "$1" number_of_pairs "$2"
+}
+
+# Run every pair of config $1 at once, all sending file $2.
+run_pairs () {
+	local n i pids=
+	n=$(cfg_get "$1" number_of_pairs)
+	for i in $(seq 1 "$n"); do
+		run_pair "$1" "$i" "$2" &
+		pids="$pids $!"
+	done
+	wait $pids
+}
@@ -0,0 +1,79 @@
+#!/bin/bash
+#
+# Payload compression on text and on random input: runs transfers
+# through the simulator (sim.c) with each input (-P) and compression
+# setting (-Z, off or a zlib level), and reports per setting the mean over SEEDS runs of:
+#
+#   goodput_kbps  file bytes over the simulated transfer time
+#   ratio         compressed bytes over input bytes compressed, 1 if none
+#   bypassed      fraction of the input sent as it is, not compressing
+#   wall_ms       real time the run took, mostly compressing and
+#                 decompressing once the codec is on
+#
+# Timestamps are on (-e), so the retransmission timeout follows the RTT.
+#
+# Settings (environment or make compress VAR=...):
+#
+#   INPUTS      -P inputs ("text random")
+#   CODECS      -Z settings compared ("off zlib:1 zlib zlib:9")
+#   LOSS        random loss rate (0)
+#   BANDWIDTH   kb/s (10000)
+#   DELAY       one-way propagation delay in ms (10)
+#   WINDOW      -w (64)
+#   SIZE        bytes per transfer (5000000)
+#   SEEDS       runs per setting, sim -s 1 to SEEDS (5)
+#   OUT         CSV written with one row per setting (bench/compress.csv)
+
+cd "$(dirname "$0")/.." || exit 1
+
+SIM=${SIM:-./sim}
+INPUTS=${INPUTS:-"text random"}
+CODECS=${CODECS:-"off zlib:1 zlib zlib:9"}
+LOSS=${LOSS:-0}
+BANDWIDTH=${BANDWIDTH:-10000}
+DELAY=${DELAY:-10}
+WINDOW=${WINDOW:-64}
+SIZE=${SIZE:-5000000}
+SEEDS=${SEEDS:-5}
+OUT=${OUT:-bench/compress.csv}
+
+. bench/common.sh
+
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/compress.XXXXXX")
+trap '[ -n "$KEEP" ] || rm -rf "$WORK"' EXIT
+
+# Value of key $2 in the sim summary line $1
+sim_val () {
+	echo "$1" | tr ' ' '\n' | sed -n "s/^$2=//p"
+}
+
+echo "input,codec,ok,goodput_kbps,ratio,bypassed,wall_ms" > "$OUT"
+printf "%-6s %-8s | %5s %10s %6s %8s %8s\n" \
+	"input" "codec" "ok" "goodput" "ratio" "bypassed" "wall_ms"
+
+for input in $INPUTS; do
+	for codec in $CODECS; do
+		ok=0
+		rm -f "$WORK/rows"
+		for seed in $(seq 1 "$SEEDS"); do
+			rm -f "$WORK/stats"
+			line=$("$SIM" -s "$seed" -n "$SIZE" -w "$WINDOW" -I 2 -e \
+				-b "$BANDWIDTH" -D "$DELAY" -l "$LOSS" -P "$input" \
+				-Z "$codec" -S "$WORK/stats")
+			[ "$(sim_val "$line" ok)" = 1 ] && ok=$((ok + 1))
+			echo "$(sim_val "$line" goodput_kbps)" \
+				"$(json_num "$WORK/stats" sender zip_bytes_in)" \
+				"$(json_num "$WORK/stats" sender zip_bytes_out)" \
+				"$(json_num "$WORK/stats" sender zip_bypassed)" \
+				"$(sim_val "$line" wall_ms)" >> "$WORK/rows"
+		done
+		row=$(awk -v size="$SIZE" '{ g += $1; i += $2; o += $3; b += $4; w += $5 }
+			END { printf "%.1f,%.3f,%.3f,%.1f", g / NR, i ? o / i : 1,
+				b / NR / size, w / NR }' "$WORK/rows")
+		echo "$input,$codec,$ok/$SEEDS,$row" >> "$OUT"
+		echo "$input $codec $ok/$SEEDS $row" | tr , ' ' | awk '{
+			printf "%-6s %-8s | %5s %10s %6s %8s %8s\n",
+				$1, $2, $3, $4, $5, $6, $7 }'
+	done
+done
+echo "results in $OUT"
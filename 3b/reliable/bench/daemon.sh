@@ -0,0 +1,116 @@
+#!/bin/bash
+#
+# Many small transfers over localhost UDP, no relayer: compares starting
+# a receiver and a sender process for every file with a receiver daemon
+# (-D) that takes them all, sent either by one sender process per file
+# or by a single sender given every file (-s repeated).  Without a
+# relayer in between, whichever end of a stand-alone pair sends first
+# gets port unreachable and gives up, so the per-file receivers also run
+# with -D, each for a single file.  Reports per mode:
+#
+#   files_per_s   transfers finished per wall second
+#   ms_per_file   mean wall time of a transfer, startup included
+#   ok            files that came out equal to the input
+#
+# Settings (environment or make daemon VAR=...):
+#
+#   FILES       transfers per mode (1000)
+#   SIZE        bytes per file (10000)
+#   PORT        port the receiver listens on (20000)
+#   TIMEOUT     seconds one process may take (30)
+#   OUT         CSV written with one row per mode (bench/daemon.csv)
+
+cd "$(dirname "$0")/.." || exit 1
+
+RELIABLE=${RELIABLE:-./reliable}
+FILES=${FILES:-1000}
+SIZE=${SIZE:-10000}
+PORT=${PORT:-20000}
+TIMEOUT=${TIMEOUT:-30}
+OUT=${OUT:-bench/daemon.csv}
+
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/daemon.XXXXXX")
+trap '[ -n "$KEEP" ] || rm -rf "$WORK"; [ -n "$DAEMON_PID" ] && kill $DAEMON_PID 2>/dev/null' EXIT
+
+head -c "$SIZE" /dev/urandom > "$WORK/in"
+
+now_ms () {
+	echo $(( $(date +%s%N) / 1000000 ))
+}
+
+# Files under directory $1 equal to the input.
+count_ok () {
+	local f n=0
+	for f in $(find "$1" -type f); do
+		cmp -s "$WORK/in" "$f" && n=$((n + 1))
+	done
+	echo $n
+}
+
+# Starts a receiver daemon writing to directory $WORK/$1, returning once
+# it listens.
+daemon_start () {
+	mkdir -p "$WORK/$1"
+	"$RELIABLE" -D -r "$WORK/$1" "$PORT" 2> "$WORK/daemon.log" &
+	DAEMON_PID=$!
+	until grep -q listening "$WORK/daemon.log"; do
+		kill -0 $DAEMON_PID 2>/dev/null || return 1
+		sleep 0.001
+	done
+}
+
+daemon_stop () {
+	kill $DAEMON_PID 2>/dev/null
+	wait $DAEMON_PID 2>/dev/null
+	DAEMON_PID=
+}
+
+# One receiver and one sender process per file.
+mode_process () {
+	local i
+	for i in $(seq 1 "$FILES"); do
+		daemon_start "process/$i"
+		timeout "$TIMEOUT" "$RELIABLE" -s "$WORK/in" \
+			"$((PORT + 1))" "localhost:$PORT" 2> /dev/null
+		daemon_stop
+	done
+}
+
+# The daemon, and one sender process per file.
+mode_daemon () {
+	local i
+	daemon_start daemon
+	for i in $(seq 1 "$FILES"); do
+		timeout "$TIMEOUT" "$RELIABLE" -s "$WORK/in" \
+			"$((PORT + 1))" "localhost:$PORT" 2> /dev/null
+	done
+	daemon_stop
+}
+
+# The daemon, and a single sender sending every file in turn.
+mode_batch () {
+	local i args=
+	daemon_start batch
+	for i in $(seq 1 "$FILES"); do
+		args="$args -s $WORK/in"
+	done
+	timeout $((TIMEOUT * FILES)) "$RELIABLE" $args \
+		"$((PORT + 1))" "localhost:$PORT" 2> /dev/null
+	daemon_stop
+}
+
+echo "mode,files,ok,files_per_s,ms_per_file" > "$OUT"
+printf "%-8s | %6s %6s %12s %12s\n" "mode" "files" "ok" "files_per_s" "ms_per_file"
+
+for mode in process daemon batch; do
+	t0=$(now_ms)
+	mode_$mode
+	t1=$(now_ms)
+	ok=$(count_ok "$WORK/$mode")
+	row=$(awk -v n="$FILES" -v ms=$((t1 - t0)) 'BEGIN {
+		printf "%.1f,%.2f", ms ? n * 1000 / ms : 0, ms / n }')
+	echo "$mode,$FILES,$ok,$row" >> "$OUT"
+	echo "$mode $FILES $ok $row" | tr , ' ' | awk '{
+		printf "%-8s | %6s %6s %12s %12s\n", $1, $2, $3, $4, $5 }'
+done
+echo "results in $OUT"
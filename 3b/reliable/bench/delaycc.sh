@@ -0,0 +1,75 @@
+#!/bin/bash
+#
+# Loss-based against delay-based congestion control: runs one transfer
+# per congestion control (-A) and random loss rate through the simulator
+# (sim.c), on a bottleneck like the relayer's default config, and
+# reports per run:
+#
+#   goodput_kbps  file bytes over the simulated transfer time
+#   util          goodput over bandwidth
+#   qavg, qmax    bottleneck queue length in packets seen by arriving
+#                 data packets, mean and largest
+#   qdelay_ms     mean time data packets waited in that queue
+#   qdrops        data packets the full queue dropped
+#   retx          sender retransmissions
+#
+# Settings (environment or make delaycc VAR=...):
+#
+#   ALGOS       congestion controls to compare ("aimd vegas ledbat")
+#   LOSSES      random loss rates ("0 0.001")
+#   BANDWIDTH   kb/s (10000)
+#   DELAY       one-way propagation delay in ms (20)
+#   BUFFER      bottleneck queue in packets (25)
+#   TARGET      -T, the queueing delay ledbat aims for in ms (5)
+#   SIZE        bytes per transfer (20000000)
+#   WINDOW      -w (64)
+#   SEED        sim -s (1)
+#   OUT         CSV written with one row per run (bench/delaycc.csv)
+
+cd "$(dirname "$0")/.." || exit 1
+
+SIM=${SIM:-./sim}
+ALGOS=${ALGOS:-"aimd vegas ledbat"}
+LOSSES=${LOSSES:-"0 0.001"}
+BANDWIDTH=${BANDWIDTH:-10000}
+DELAY=${DELAY:-20}
+BUFFER=${BUFFER:-25}
+TARGET=${TARGET:-5}
+SIZE=${SIZE:-20000000}
+WINDOW=${WINDOW:-64}
+SEED=${SEED:-1}
+OUT=${OUT:-bench/delaycc.csv}
+
+. bench/common.sh
+
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/delaycc.XXXXXX")
+trap '[ -n "$KEEP" ] || rm -rf "$WORK"' EXIT
+
+# Value of key $2 in the sim summary line $1
+sim_val () {
+	echo "$1" | tr ' ' '\n' | sed -n "s/^$2=//p"
+}
+
+echo "algo,loss,ok,goodput_kbps,util,qavg,qmax,qdelay_ms,qdrops,retx" > "$OUT"
+printf "%-7s %6s | %3s %10s %6s %6s %5s %9s %7s %6s\n" \
+	"algo" "loss" "ok" "goodput" "util" "qavg" "qmax" "qdelay ms" "qdrops" "retx"
+
+for loss in $LOSSES; do
+	for algo in $ALGOS; do
+		rm -f "$WORK/stats"
+		line=$("$SIM" -s "$SEED" -n "$SIZE" -w "$WINDOW" -b "$BANDWIDTH" \
+			-D "$DELAY" -q "$BUFFER" -l "$loss" -A "$algo" -T "$TARGET" \
+			-S "$WORK/stats")
+		ok=$(sim_val "$line" ok)
+		g=$(sim_val "$line" goodput_kbps)
+		row=$(awk -v g="$g" -v bw="$BANDWIDTH" 'BEGIN { printf "%.1f,%.3f", g, g / bw }')
+		row="$row,$(sim_val "$line" fwd_qavg),$(sim_val "$line" fwd_qmax)"
+		row="$row,$(sim_val "$line" fwd_qdelay_ms),$(sim_val "$line" fwd_qdrops)"
+		row="$row,$(json_num "$WORK/stats" sender retransmits)"
+		echo "$algo,$loss,${ok:-0},$row" >> "$OUT"
+		echo "$algo $loss ${ok:-0} $row" | tr , ' ' | awk '{
+			printf "%-7s %6s | %3s %10s %6s %6s %5s %9s %7s %6s\n",
+				$1, $2, ($3 ? "ok" : "BAD"), $4, $5, $6, $7, $8, $9, $10 }'
+	done
+done
+echo "results in $OUT"
@@ -0,0 +1,181 @@
+#!/bin/bash
+#
+# Fairness and convergence benchmark: runs PAIRS sender/receiver pairs
+# through one relayer bottleneck, starting pair i at (i-1) x STAGGER
+# seconds, and asks every process for its statistics (SIGUSR1) each
+# SAMPLE seconds.  From the receivers' bytes_delivered it computes each
+# flow's goodput per SAMPLE interval and reports:
+#
+#   jain          Jain's fairness index (sum x)^2 / (n sum x^2) over the
+#                 flows active in an interval, averaged over the
+#                 intervals in which all PAIRS flows are active
+#   converge_s    seconds from the last flow's start until the index
+#                 reaches THRESHOLD and stays there while all flows are
+#                 active ("none" if it never does)
+#   util          summed goodput over the bottleneck bandwidth, averaged
+#                 over the same intervals
+#
+# plus each flow's completion time and average goodput.  The per
+# interval series goes to OUT as CSV: t_s,active,jain,util and one
+# goodput column per flow.
+#
+# Settings (environment or make fairness VAR=...):
+#
+#   PAIRS       flows sharing the bottleneck (3)
+#   STAGGER     seconds between flow starts, 0 for simultaneous (2)
+#   SAMPLE      sampling interval in seconds (0.5)
+#   THRESHOLD   Jain's index that counts as converged (0.9)
+#   SIZE        bytes per flow (3000000)
+#   WINDOW      -w for both ends (64)
+#   BANDWIDTH, DELAY, BUFFER
+#               override the config's bandwidth (kb/s),
+#               propagation_delay (ms) and buffer_size (packets)
+#   OUT         CSV of the per interval series (bench/fairness.csv)
+#   RELIABLE, RELAYER, CONFIG, TIMEOUT as for bench.sh
+
+cd "$(dirname "$0")/.." || exit 1
+
+RELIABLE=${RELIABLE:-./reliable}
+RELAYER=${RELAYER:-../relayer/relayer}
+CONFIG=${CONFIG:-../relayer/config.xml}
+PAIRS=${PAIRS:-3}
+STAGGER=${STAGGER:-2}
+SAMPLE=${SAMPLE:-0.5}
+THRESHOLD=${THRESHOLD:-0.9}
+SIZE=${SIZE:-3000000}
+WINDOW=${WINDOW:-64}
+OUT=${OUT:-bench/fairness.csv}
+TIMEOUT=${TIMEOUT:-120}
+RELIABLE_OPTS="-w $WINDOW $RELIABLE_OPTS"
+
+. bench/common.sh
+
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/fairness.XXXXXX")
+trap 'kill $SAMPLER_PID 2>/dev/null; relayer_stop; [ -n "$KEEP" ] || rm -rf "$WORK"' EXIT
+
+cfg="$WORK/config.xml"
+cp "$CONFIG" "$cfg"
+cfg_fix_cpu "$cfg"
+cfg_write_pairs "$cfg" "$PAIRS"
+[ -n "$BANDWIDTH" ] && cfg_set "$cfg" "$cfg" bandwidth "$BANDWIDTH"
+[ -n "$DELAY" ] && cfg_set "$cfg" "$cfg" propagation_delay "$DELAY"
+[ -n "$BUFFER" ] && cfg_set "$cfg" "$cfg" buffer_size "$BUFFER"
+bw=$(cfg_get "$cfg" bandwidth)
+head -c "$SIZE" /dev/urandom > "$WORK/input"
+
+# SIGUSR1 every reliable of this run each SAMPLE seconds.  A process is
+# only signalled once it catches SIGUSR1 (bit 10 of SigCgt), since the
+# default action would kill it.
+sampler () {
+	local p mask
+	while :; do
+		for p in $(pgrep -x reliable); do
+			tr '\0' ' ' < "/proc/$p/cmdline" 2>/dev/null | grep -q "$WORK" || continue
+			mask=$(awk '/^SigCgt/ { print $2 }' "/proc/$p/status" 2>/dev/null)
+			[ -n "$mask" ] && (( 0x$mask & 0x200 )) && kill -USR1 "$p" 2>/dev/null
+		done
+		sleep "$SAMPLE"
+	done
+}
+
+relayer_start "$cfg" || exit 1
+sampler &
+SAMPLER_PID=$!
+pids=
+for i in $(seq 1 "$PAIRS"); do
+	( sleep "$(awk -v i="$i" -v s="$STAGGER" 'BEGIN { print (i - 1) * s }')"
+	  run_pair "$cfg" "$i" "$WORK/input" ) &
+	pids="$pids $!"
+done
+wait $pids
+kill $SAMPLER_PID 2>/dev/null
+wait $SAMPLER_PID 2>/dev/null
+relayer_stop
+
+ok=1
+for i in $(seq 1 "$PAIRS"); do
+	cmp -s "$WORK/input" "$WORK/out.$i" || ok=0
+	# flow clock_ms elapsed_ms bytes_delivered, one line per sample
+	grep '"role":"receiver"' "$WORK/stats.$i" | sed -n \
+		"s/.*\"clock_ms\":\([0-9.]*\),\"elapsed_ms\":\([0-9.]*\),.*\"bytes_delivered\":\([0-9]*\).*/$i \1 \2 \3/p"
+done > "$WORK/samples"
+
+awk -v n="$PAIRS" -v w="$SAMPLE" -v bw="$bw" -v thr="$THRESHOLD" \
+	-v out="$OUT" -v ok="$ok" -v size="$SIZE" '
+	# Bytes flow f had delivered at time t, interpolated between samples
+	function cum(f, t,   k) {
+		if (t <= T[f, 0])
+			return 0
+		for (k = 1; k < m[f]; k++)
+			if (t <= T[f, k])
+				return B[f, k-1] + (B[f, k] - B[f, k-1]) * (t - T[f, k-1]) / (T[f, k] - T[f, k-1])
+		return B[f, m[f] - 1]
+	}
+	{
+		f = $1
+		if (!(f in m)) {
+			# the receiver started elapsed_ms before its first sample
+			T[f, 0] = ($2 - $3) / 1000; B[f, 0] = 0; m[f] = 1
+		}
+		T[f, m[f]] = $2 / 1000; B[f, m[f]] = $4; m[f]++
+	}
+	END {
+		t0 = 1e30; last_start = 0; first_end = 1e30; t_end = 0
+		for (f = 1; f <= n; f++) {
+			if (!(f in m)) {
+				print "flow " f " reported no statistics" > "/dev/stderr"
+				exit 1
+			}
+			start[f] = T[f, 0]; end[f] = T[f, m[f] - 1]
+			if (start[f] < t0) t0 = start[f]
+			if (start[f] > last_start) last_start = start[f]
+			if (end[f] < first_end) first_end = end[f]
+			if (end[f] > t_end) t_end = end[f]
+		}
+
+		printf "t_s,active,jain,util" > out
+		for (f = 1; f <= n; f++)
+			printf ",flow%d_kbps", f > out
+		printf "\n" > out
+
+		nall = 0; jsum = 0; usum = 0; conv = -1
+		for (a = t0; a + w <= t_end; a += w) {
+			b = a + w; active = 0; sx = 0; sxx = 0
+			for (f = 1; f <= n; f++) {
+				x[f] = ""
+				if (start[f] <= a && b <= end[f]) {
+					x[f] = (cum(f, b) - cum(f, a)) * 8 / w / 1000
+					active++; sx += x[f]; sxx += x[f] * x[f]
+				}
+			}
+			j = (sxx > 0 ? sx * sx / (active * sxx) : 0)
+			printf "%.3f,%d,%.4f,%.4f", a - t0, active, j, sx / bw > out
+			for (f = 1; f <= n; f++)
+				printf (x[f] == "" ? ",%s" : ",%.1f"), x[f] > out
+			printf "\n" > out
+
+			if (active == n) {
+				nall++; jsum += j; usum += sx / bw
+				if (j < thr)
+					conv = -1
+				else if (conv < 0)
+					conv = a - last_start
+			}
+		}
+
+		printf "flows %d  ok %s\n", n, (ok ? "yes" : "NO")
+		for (f = 1; f <= n; f++) {
+			d = end[f] - start[f]
+			printf "  flow %d: start %6.2f s  done %6.2f s  %9.1f kb/s\n",
+				f, start[f] - t0, end[f] - t0, (d > 0 ? size * 8 / d / 1000 : 0)
+		}
+		if (nall == 0) {
+			print "no interval with all flows active; raise SIZE or lower STAGGER"
+			exit
+		}
+		printf "jain %.4f  converge_s %s  util %.3f  (%d intervals of %s s with all flows)\n",
+			jsum / nall, (conv < 0 ? "none" : sprintf("%.2f", (conv > 0 ? conv : 0))),
+			usum / nall, nall, w
+	}' "$WORK/samples" || exit 1
+echo "series in $OUT"
+[ "$ok" = 1 ]
@@ -0,0 +1,79 @@
+#!/bin/bash
+#
+# Forward error correction on a long, lossy path: runs transfers through
+# the simulator (sim.c) at each loss rate with parity off, at a fixed
+# group size and sized to the loss measured (-F auto), and reports per
+# setting the mean over SEEDS runs of:
+#
+#   goodput_kbps  file bytes over the simulated transfer time
+#   retx          sender retransmissions
+#   parity        parity packets sent
+#   rebuilt       lost packets the receiver rebuilt from them
+#   group         packets per parity at the end of the transfer
+#
+# Timestamps are on (-e), so the retransmission timeout follows the
+# RTT; at the fixed timeout, below this RTT, spurious timeouts drown
+# everything else.
+#
+# Settings (environment or make fec VAR=...):
+#
+#   LOSSES      random loss rates ("0 0.01 0.05")
+#   FECS        -F settings compared ("off 8 auto")
+#   BANDWIDTH   kb/s (10000)
+#   DELAY       one-way propagation delay in ms (50)
+#   WINDOW      -w (64)
+#   SIZE        bytes per transfer (2000000)
+#   SEEDS       runs per setting, sim -s 1 to SEEDS (10)
+#   OUT         CSV written with one row per setting (bench/fec.csv)
+
+cd "$(dirname "$0")/.." || exit 1
+
+SIM=${SIM:-./sim}
+LOSSES=${LOSSES:-"0 0.01 0.05"}
+FECS=${FECS:-"off 8 auto"}
+BANDWIDTH=${BANDWIDTH:-10000}
+DELAY=${DELAY:-50}
+WINDOW=${WINDOW:-64}
+SIZE=${SIZE:-2000000}
+SEEDS=${SEEDS:-10}
+OUT=${OUT:-bench/fec.csv}
+
+. bench/common.sh
+
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/fec.XXXXXX")
+trap '[ -n "$KEEP" ] || rm -rf "$WORK"' EXIT
+
+# Value of key $2 in the sim summary line $1
+sim_val () {
+	echo "$1" | tr ' ' '\n' | sed -n "s/^$2=//p"
+}
+
+echo "loss,fec,ok,goodput_kbps,retx,parity,rebuilt,group" > "$OUT"
+printf "%-5s %-5s | %5s %10s %7s %7s %7s %6s\n" \
+	"loss" "fec" "ok" "goodput" "retx" "parity" "rebuilt" "group"
+
+for loss in $LOSSES; do
+	for fec in $FECS; do
+		ok=0
+		rm -f "$WORK/rows"
+		for seed in $(seq 1 "$SEEDS"); do
+			rm -f "$WORK/stats"
+			line=$("$SIM" -s "$seed" -n "$SIZE" -w "$WINDOW" -I 2 -e \
+				-b "$BANDWIDTH" -D "$DELAY" -l "$loss" -F "$fec" \
+				-S "$WORK/stats")
+			[ "$(sim_val "$line" ok)" = 1 ] && ok=$((ok + 1))
+			echo "$(sim_val "$line" goodput_kbps)" \
+				"$(json_num "$WORK/stats" sender retransmits)" \
+				"$(json_num "$WORK/stats" sender fec_sent)" \
+				"$(json_num "$WORK/stats" receiver fec_rebuilt)" \
+				"$(json_num "$WORK/stats" sender fec_group)" >> "$WORK/rows"
+		done
+		row=$(awk '{ g += $1; r += $2; p += $3; b += $4; s += $5 }
+			END { printf "%.1f,%.1f,%.1f,%.1f,%.1f", g / NR, r / NR, p / NR, b / NR, s / NR }' "$WORK/rows")
+		echo "$loss,$fec,$ok/$SEEDS,$row" >> "$OUT"
+		echo "$loss $fec $ok/$SEEDS $row" | tr , ' ' | awk '{
+			printf "%-5s %-5s | %5s %10s %7s %7s %7s %6s\n",
+				$1, $2, $3, $4, $5, $6, $7, $8 }'
+	done
+done
+echo "results in $OUT"
@@ -0,0 +1,166 @@
+/*
+ Microbenchmark for the receiving window.  Feeds a stream of seqnos
+ through a reorderer (with probability p a packet is held back by 1 to
+ depth positions) into recvwin, delivering in order as packets become
+ available, and into the linked list gap-filling scheme recvwin
+ replaced.  Prints nanoseconds per packet for each.
+
+   usage: recvwin_bench [packets [window [depth]]]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#include "../rlib.h"
+#include "../recvwin.h"
+
+void *xmalloc(size_t n){
+	void *p = malloc(n);
+	if(!p){
+		fprintf(stderr, "out of memory allocating %d bytes\n", (int)n);
+		abort();
+	}
+	return p;
+}
+
+/* The old receiving window: a list with an entry for every seqno from
+ * the next expected one up to the highest seen, holes included. */
+typedef struct list_entry{
+	struct list_entry *next;
+	packet_t pkt;
+	int valid;
+}list_entry;
+
+static list_entry *list_head;
+static uint32_t list_base = 1;
+
+static void list_insert(packet_t *pkt){
+	list_entry *cur, *nw;
+	if(pkt->seqno < list_base)
+		return;
+	if(!list_head){
+		list_head = xmalloc(sizeof(list_entry));
+		memset(list_head, 0, sizeof(list_entry));
+		list_head->pkt.seqno = list_base;
+	}
+	for(cur = list_head; cur->pkt.seqno <= pkt->seqno; cur = cur->next){
+		if(cur->pkt.seqno == pkt->seqno){
+			if(!cur->valid){
+				memcpy(&cur->pkt, pkt, sizeof(packet_t));
+				cur->valid = 1;
+			}
+			return;
+		}
+		if(!cur->next || cur->next->pkt.seqno != cur->pkt.seqno + 1){
+			nw = xmalloc(sizeof(list_entry));
+			memset(nw, 0, sizeof(list_entry));
+			nw->pkt.seqno = cur->pkt.seqno + 1;
+			nw->next = cur->next;
+			cur->next = nw;
+		}
+	}
+}
+
+static uint32_t list_deliver(void){
+	uint32_t n = 0;
+	while(list_head && list_head->valid){
+		list_entry *e = list_head;
+		list_head = e->next;
+		free(e);
+		list_base++;
+		n++;
+	}
+	return n;
+}
+
+static uint32_t win_deliver(recvwin *w){
+	uint32_t n = 0;
+	while(recvwin_peek(w)){
+		recvwin_advance(w);
+		n++;
+	}
+	return n;
+}
+
+/* Arrival order: packet i is held back with probability p and released
+ * between 1 and depth packets later. */
+static uint32_t *make_order(uint32_t n, double p, uint32_t depth){
+	uint32_t *order = xmalloc(n * sizeof(uint32_t));
+	uint32_t i;
+	for(i = 0; i < n; i++){
+		order[i] = i + 1;
+	}
+	for(i = 0; i + 1 < n; i++){
+		if(rand() < p * RAND_MAX){
+			uint32_t d = 1 + rand() % depth;
+			uint32_t j, held = order[i];
+			if(i + d >= n)
+				d = n - 1 - i;
+			for(j = i; j < i + d; j++){
+				order[j] = order[j + 1];
+			}
+			order[i + d] = held;
+		}
+	}
+	return order;
+}
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv){
+	uint32_t n = argc > 1 ? atoi(argv[1]) : 1000000;
+	uint32_t window = argc > 2 ? atoi(argv[2]) : 256;
+	uint32_t depth = argc > 3 ? atoi(argv[3]) : 32;
+	double probs[] = { 0, 0.02, 0.20 };
+	packet_t pkt;
+	uint32_t i, k;
+
+	memset(&pkt, 0, sizeof(pkt));
+	pkt.len = 16 + 1000;
+	printf("%u packets, window %u, reorder depth %u\n", n, window, depth);
+	printf("%8s %14s %14s\n", "reorder", "recvwin ns/pkt", "list ns/pkt");
+	for(k = 0; k < sizeof(probs) / sizeof(probs[0]); k++){
+		uint32_t *order;
+		recvwin w;
+		uint32_t got = 0;
+		double t0, t_win, t_list;
+
+		srand(1);
+		order = make_order(n, probs[k], depth < window ? depth : window - 1);
+
+		recvwin_init(&w, 1, window, true);
+		t0 = now();
+		for(i = 0; i < n; i++){
+			pkt.seqno = order[i];
+			recvwin_insert(&w, pkt.seqno, &pkt, pkt.len);
+			got += win_deliver(&w);
+		}
+		t_win = now() - t0;
+		recvwin_free(&w);
+		if(got != n)
+			fprintf(stderr, "recvwin delivered %u of %u\n", got, n);
+
+		got = 0;
+		list_base = 1;
+		t0 = now();
+		for(i = 0; i < n; i++){
+			pkt.seqno = order[i];
+			list_insert(&pkt);
+			got += list_deliver();
+		}
+		t_list = now() - t0;
+		if(got != n)
+			fprintf(stderr, "list delivered %u of %u\n", got, n);
+
+		printf("%7.0f%% %14.1f %14.1f\n", probs[k] * 100, t_win * 1e9 / n, t_list * 1e9 / n);
+		free(order);
+	}
+	return 0;
+}
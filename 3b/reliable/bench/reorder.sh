@@ -0,0 +1,100 @@
+#!/bin/bash
+#
+# Fixed against adaptive duplicate ack threshold under reordering: runs
+# transfers through the simulator (sim.c) with each reordering rate,
+# with and without timestamps (-e), once with the threshold fixed at 3
+# (-R 3) and once adapting to the reordering seen, and reports per
+# setting the mean over SEEDS runs of:
+#
+#   goodput_kbps  file bytes over the simulated transfer time
+#   retx          sender retransmissions
+#   undos         loss cuts undone because the hole was only reordered
+#   dupthresh     the threshold at the end of the transfer
+#
+# The receiver's window bounds the flight (-I 2 opens the handshake that
+# announces it), so the queue stays below the fixed retransmission
+# timeout and the runs measure loss detection rather than timeouts.
+#
+# Two more settings follow on a short path with a queue of 25 packets
+# and a window of 32, where the packets limited transmit sends past the
+# window must stay few or they overrun the receiver's window: one with
+# the threshold fixed at 4 and no reordering (mode tight-R4), one
+# adapting to 10% reordering (mode tight).
+#
+# Settings (environment or make reorder VAR=...):
+#
+#   REORDERS    probabilities of holding a packet back ("0.02 0.1")
+#   REORDER_MS  up to how long, -O (5)
+#   LOSS        random loss rate, so that there are real losses to find (0.01)
+#   BANDWIDTH   kb/s (10000)
+#   DELAY       one-way propagation delay in ms (15)
+#   WINDOW      -w (64)
+#   SIZE        bytes per transfer (5000000)
+#   SEEDS       runs per setting, sim -s 1 to SEEDS (10)
+#   OUT         CSV written with one row per setting (bench/reorder.csv)
+
+cd "$(dirname "$0")/.." || exit 1
+
+SIM=${SIM:-./sim}
+REORDERS=${REORDERS:-"0.02 0.1"}
+REORDER_MS=${REORDER_MS:-5}
+LOSS=${LOSS:-0.01}
+BANDWIDTH=${BANDWIDTH:-10000}
+DELAY=${DELAY:-15}
+WINDOW=${WINDOW:-64}
+SIZE=${SIZE:-5000000}
+SEEDS=${SEEDS:-10}
+OUT=${OUT:-bench/reorder.csv}
+
+. bench/common.sh
+
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/reorder.XXXXXX")
+trap '[ -n "$KEEP" ] || rm -rf "$WORK"' EXIT
+
+# Value of key $2 in the sim summary line $1
+sim_val () {
+	echo "$1" | tr ' ' '\n' | sed -n "s/^$2=//p"
+}
+
+# Runs SEEDS transfers with sim options $4... and prints the row for
+# reordering $1, timestamps $2 and threshold mode $3.
+run () {
+	local reorder=$1 ts=$2 mode=$3 ok=0 seed line row
+	shift 3
+	rm -f "$WORK/rows"
+	for seed in $(seq 1 "$SEEDS"); do
+		rm -f "$WORK/stats"
+		line=$("$SIM" -s "$seed" "$@" -S "$WORK/stats")
+		[ "$(sim_val "$line" ok)" = 1 ] && ok=$((ok + 1))
+		echo "$(sim_val "$line" goodput_kbps)" \
+			"$(json_num "$WORK/stats" sender retransmits)" \
+			"$(json_num "$WORK/stats" sender reorder_undos)" \
+			"$(json_num "$WORK/stats" sender dupthresh)" >> "$WORK/rows"
+	done
+	row=$(awk '{ g += $1; r += $2; u += $3; d += $4 }
+		END { printf "%.1f,%.1f,%.1f,%.1f", g / NR, r / NR, u / NR, d / NR }' "$WORK/rows")
+	echo "$reorder,$ts,$mode,$ok/$SEEDS,$row" >> "$OUT"
+	echo "$reorder $ts $mode $ok/$SEEDS $row" | tr , ' ' | awk '{
+		printf "%-7s %-3s %-8s | %5s %10s %7s %6s %9s\n",
+			$1, $2, $3, $4, $5, $6, $7, $8 }'
+}
+
+echo "reorder,timestamps,dupthresh_mode,ok,goodput_kbps,retx,undos,dupthresh" > "$OUT"
+printf "%-7s %-3s %-8s | %5s %10s %7s %6s %9s\n" \
+	"reorder" "ts" "mode" "ok" "goodput" "retx" "undos" "dupthresh"
+
+for reorder in $REORDERS; do
+	for ts in off on; do
+		for mode in fixed adaptive; do
+			opts=""
+			[ $ts = on ] && opts="$opts -e"
+			[ $mode = fixed ] && opts="$opts -R 3"
+			run "$reorder" $ts $mode -n "$SIZE" -w "$WINDOW" -I 2 \
+				-b "$BANDWIDTH" -D "$DELAY" -l "$LOSS" \
+				-o "$reorder" -O "$REORDER_MS" $opts
+		done
+	done
+done
+run 0 off tight-R4 -n 300000 -w 32 -b 100000 -D 1 -q 25 -R 4
+run 0.1 off tight -n 300000 -w 32 -b 100000 -D 1 -q 25 -o 0.1 -l 0.01
+echo "results in $OUT"
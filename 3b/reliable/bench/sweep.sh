@@ -0,0 +1,95 @@
+#!/bin/bash
+#
+# Parameter sweep over the relayer's bottleneck: for every combination
+# of bandwidth, propagation delay and buffer size (as a multiple of the
+# bandwidth-delay product) it writes a config, runs PAIRS sender/receiver
+# pairs through it at once, and reports per cell:
+#
+#   goodput_kbps  file bytes over the slowest pair's completion time,
+#                 summed over pairs
+#   util          goodput over bandwidth
+#   queue_ms      sender SRTT at the end of the run minus the base RTT
+#                 (2 x propagation_delay), averaged over pairs
+#   loss          retransmitted over total data packets, all pairs
+#
+# Settings (environment or make sweep VAR=...):
+#
+#   BANDWIDTHS  kb/s ("1000 10000 49000"; the relayer wants < 50000)
+#   DELAYS      one-way propagation delay in ms ("5 20 50 200")
+#   BUFFERS     buffer_size as a multiple of BDP ("0.25 1 4")
+#   PAIRS       concurrent pairs per cell (1)
+#   SIZE        bytes per pair (500000)
+#   WINDOW      -w for both ends (64)
+#   OUT         CSV written with one row per cell (bench/sweep.csv)
+#   RELIABLE, RELAYER, CONFIG, TIMEOUT as for bench.sh
+
+cd "$(dirname "$0")/.." || exit 1
+
+RELIABLE=${RELIABLE:-./reliable}
+RELAYER=${RELAYER:-../relayer/relayer}
+CONFIG=${CONFIG:-../relayer/config.xml}
+BANDWIDTHS=${BANDWIDTHS:-"1000 10000 49000"}
+DELAYS=${DELAYS:-"5 20 50 200"}
+BUFFERS=${BUFFERS:-"0.25 1 4"}
+PAIRS=${PAIRS:-1}
+SIZE=${SIZE:-500000}
+WINDOW=${WINDOW:-64}
+OUT=${OUT:-bench/sweep.csv}
+TIMEOUT=${TIMEOUT:-120}
+RELIABLE_OPTS="-w $WINDOW $RELIABLE_OPTS"
+
+. bench/common.sh
+
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/sweep.XXXXXX")
+trap 'relayer_stop; [ -n "$KEEP" ] || rm -rf "$WORK"' EXIT
+
+cp "$CONFIG" "$WORK/base.xml"
+cfg_fix_cpu "$WORK/base.xml"
+cfg_write_pairs "$WORK/base.xml" "$PAIRS"
+head -c "$SIZE" /dev/urandom > "$WORK/input"
+
+echo "bandwidth_kbps,delay_ms,buffer_bdp,buffer_pkts,pairs,ok,goodput_kbps,util,queue_ms,loss" > "$OUT"
+printf "%9s %6s %6s %5s | %3s %10s %6s %9s %7s\n" \
+	"bw kb/s" "delay" "xBDP" "pkts" "ok" "goodput" "util" "queue ms" "loss"
+
+for bw in $BANDWIDTHS; do
+	for delay in $DELAYS; do
+		for mult in $BUFFERS; do
+			# BDP in 1016-byte packets, RTT being two propagation delays
+			pkts=$(awk -v bw="$bw" -v d="$delay" -v m="$mult" 'BEGIN {
+				p = int(bw * 1000 / 8 * 2 * d / 1000 / 1016 * m + 0.5)
+				print (p < 1 ? 1 : p) }')
+			cfg="$WORK/cell.xml"
+			cp "$WORK/base.xml" "$cfg"
+			cfg_set "$cfg" "$cfg" bandwidth "$bw"
+			cfg_set "$cfg" "$cfg" propagation_delay "$delay"
+			cfg_set "$cfg" "$cfg" buffer_size "$pkts"
+
+			relayer_start "$cfg" || exit 1
+			run_pairs "$cfg" "$WORK/input"
+			relayer_stop
+
+			ok=1 maxms=0 sent=0 retx=0 qsum=0
+			for i in $(seq 1 "$PAIRS"); do
+				cmp -s "$WORK/input" "$WORK/out.$i" || ok=0
+				ms=$(cat "$WORK/wall.$i")
+				[ "$ms" -gt "$maxms" ] && maxms=$ms
+				s=$(json_num "$WORK/stats.$i" sender pkts_sent)
+				r=$(json_num "$WORK/stats.$i" sender retransmits)
+				q=$(json_num "$WORK/stats.$i" sender srtt_ms)
+				sent=$((sent + ${s:-0}))
+				retx=$((retx + ${r:-0}))
+				qsum=$(awk -v a="$qsum" -v q="${q:-0}" -v d="$delay" 'BEGIN { print a + q - 2 * d }')
+			done
+			row=$(awk -v bw="$bw" -v n="$PAIRS" -v b="$SIZE" -v ms="$maxms" \
+				-v s="$sent" -v r="$retx" -v q="$qsum" 'BEGIN {
+				g = (ms > 0 ? n * b * 8 / ms : 0)
+				printf "%.1f,%.3f,%.1f,%.4f", g, g / bw, q / n, (s > 0 ? r / s : 0) }')
+			echo "$bw,$delay,$mult,$pkts,$PAIRS,$ok,$row" >> "$OUT"
+			echo "$bw $delay $mult $pkts $ok $row" | tr , ' ' | awk '{
+				printf "%9s %6s %6s %5s | %3s %10s %6s %9s %7s\n",
+					$1, $2, $3, $4, ($5 ? "ok" : "BAD"), $6, $7, $8, $9 }'
+		done
+	done
+done
+echo "results in $OUT"
@@ -0,0 +1,122 @@
+#!/bin/bash
+#
+# Completion time of short transfers with and without the peer cache
+# (dstcache.h): sends RUNS files of SIZE bytes through the relayer to a
+# receiver daemon (-D), first each from a sender process of its own, so
+# every connection starts cold, then all from one sender (-s repeated),
+# so every connection after the first starts from what the ones before
+# it left in the cache.  Reports per mode the mean and median
+# elapsed_ms of the senders' connections, the mean initial window the
+# cache gave and the mean retransmissions.
+#
+# Settings (environment or make warmstart VAR=...):
+#
+#   RUNS        transfers per mode (20)
+#   SIZE        bytes per transfer (100000)
+#   WINDOW      -w for both ends (64)
+#   BANDWIDTH, DELAY, BUFFER
+#               override the config's bandwidth (kb/s),
+#               propagation_delay (ms) and buffer_size (packets)
+#   OUT         CSV written with one row per mode (bench/warmstart.csv)
+#   RELIABLE, RELAYER, CONFIG, TIMEOUT as for bench.sh
+
+cd "$(dirname "$0")/.." || exit 1
+
+RELIABLE=${RELIABLE:-./reliable}
+RELAYER=${RELAYER:-../relayer/relayer}
+CONFIG=${CONFIG:-../relayer/config.xml}
+RUNS=${RUNS:-20}
+SIZE=${SIZE:-100000}
+WINDOW=${WINDOW:-64}
+OUT=${OUT:-bench/warmstart.csv}
+TIMEOUT=${TIMEOUT:-60}
+
+. bench/common.sh
+
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/warmstart.XXXXXX")
+trap 'kill $DAEMON_PID 2>/dev/null; relayer_stop; [ -n "$KEEP" ] || rm -rf "$WORK"' EXIT
+
+cfg="$WORK/config.xml"
+cp "$CONFIG" "$cfg"
+cfg_fix_cpu "$cfg"
+cfg_write_pairs "$cfg" 1
+[ -n "$BANDWIDTH" ] && cfg_set "$cfg" "$cfg" bandwidth "$BANDWIDTH"
+[ -n "$DELAY" ] && cfg_set "$cfg" "$cfg" propagation_delay "$DELAY"
+[ -n "$BUFFER" ] && cfg_set "$cfg" "$cfg" buffer_size "$BUFFER"
+s_src=$(cfg_pair "$cfg" sender src 1)
+s_dst=$(cfg_pair "$cfg" sender dst 1)
+r_src=$(cfg_pair "$cfg" receiver src 1)
+head -c "$SIZE" /dev/urandom > "$WORK/input"
+
+# Starts a receiver daemon writing to directory $WORK/$1.
+daemon_start () {
+	mkdir -p "$WORK/$1"
+	"$RELIABLE" -w "$WINDOW" $RELIABLE_OPTS -D -r "$WORK/$1" "$(port_of "$r_src")" \
+		2> "$WORK/$1.log" &
+	DAEMON_PID=$!
+	sleep 0.2
+}
+
+daemon_stop () {
+	kill $DAEMON_PID 2>/dev/null
+	wait $DAEMON_PID 2>/dev/null
+}
+
+# Sends with the arguments given, stats to $WORK/$1.stats.
+send () {
+	local mode=$1
+	shift
+	timeout "$TIMEOUT" "$RELIABLE" -w "$WINDOW" $RELIABLE_OPTS -S "$WORK/$mode.stats" "$@" \
+		"$(port_of "$s_src")" "$s_dst" 2>> "$WORK/$mode.sender.log"
+}
+
+# Files in directory $1 equal to the input.
+count_ok () {
+	local f n=0
+	for f in "$1"/*; do
+		cmp -s "$WORK/input" "$f" && n=$((n + 1))
+	done
+	echo $n
+}
+
+# Mean and median elapsed_ms, mean cached_window and retransmits of the
+# sender records in $1, skipping the first $2.
+summarize () {
+	grep '"role":"sender"' "$1" | tail -n +$(($2 + 1)) | sed -n \
+		's/.*"elapsed_ms":\([0-9.]*\).*"retransmits":\([0-9]*\).*"cached_window":\([0-9]*\).*/\1 \3 \2/p' |
+		sort -n | awk '{ t[NR] = $1; s += $1; w += $2; x += $3 }
+		END { m = NR % 2 ? t[(NR + 1) / 2] : (t[NR / 2] + t[NR / 2 + 1]) / 2
+			printf "%d,%.1f,%.1f,%.1f,%.1f", NR, s / NR, m, w / NR, x / NR }'
+}
+
+relayer_start "$cfg" || exit 1
+
+echo "mode,ok,transfers,mean_ms,median_ms,cached_window,retransmits" > "$OUT"
+printf "%-5s | %5s %9s %9s %9s %14s %11s\n" \
+	"mode" "ok" "transfers" "mean_ms" "median_ms" "cached_window" "retransmits"
+
+for mode in cold warm; do
+	daemon_start "$mode"
+	if [ "$mode" = cold ]; then
+		for i in $(seq 1 "$RUNS"); do
+			send cold -s "$WORK/input"
+		done
+		skip=0
+	else
+		args=
+		for i in $(seq 0 "$RUNS"); do
+			args="$args -s $WORK/input"
+		done
+		# the first connection has nothing cached yet
+		send warm $args
+		skip=1
+	fi
+	sleep 0.2
+	daemon_stop
+	ok=$(count_ok "$WORK/$mode")
+	row=$(summarize "$WORK/$mode.stats" $skip)
+	echo "$mode,$ok,$row" >> "$OUT"
+	echo "$mode $ok $row" | tr , ' ' | awk '{
+		printf "%-5s | %5s %9s %9s %9s %14s %11s\n", $1, $2, $3, $4, $5, $6, $7 }'
+done
+echo "results in $OUT"
@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#include "rlib.h"
+#include "clock.h"
+
+static uint64_t cached;
+static int cached_valid;
+static int clock_id = CLOCK_MONOTONIC;
+static uint64_t (*source) (void);
+
+uint64_t
+clock_now (void)
+{
+  if (!cached_valid)
+    return clock_refresh ();
+  return cached;
+}
+
+uint64_t
+clock_refresh (void)
+{
+  struct timespec ts;
+
+  if (source)
+    cached = source ();
+  else if (clock_gettime (clock_id, &ts) == 0)
+    cached = ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+  else
+    perror ("clock_gettime");
+  cached_valid = 1;
+  return cached;
+}
+
+void
+clock_set_coarse (int on)
+{
+#ifdef CLOCK_MONOTONIC_COARSE
+  clock_id = on ? CLOCK_MONOTONIC_COARSE : CLOCK_MONOTONIC;
+#endif /* CLOCK_MONOTONIC_COARSE */
+  cached_valid = 0;
+}
+
+void
+clock_set_source (uint64_t (*fn) (void))
+{
+  source = fn;
+  cached_valid = 0;
+}
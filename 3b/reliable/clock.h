@@ -0,0 +1,41 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+
+/* -----------------------------------------------------------------------
+
+   Time source for rlib and reliable.c.
+
+   All timing (retransmission, RTT samples, statistics, pcap
+   timestamps) reads clock_now, which returns a value cached by the
+   last clock_refresh instead of asking the kernel each time.
+   conn_poll refreshes it once per iteration, right after poll
+   returns, so everything handled in one iteration sees the same
+   instant.
+
+   The source is CLOCK_MONOTONIC by default.  clock_set_coarse
+   switches to CLOCK_MONOTONIC_COARSE where available, which is
+   cheaper but only as precise as the kernel tick, and
+   clock_set_source replaces the clock altogether, as the simulator
+   does with its virtual time.
+
+ */
+
+#define NSEC_PER_MSEC	1000000ULL
+#define NSEC_PER_SEC	1000000000ULL
+
+/* Nanoseconds since an arbitrary origin, as of the last refresh. */
+uint64_t clock_now (void);
+
+/* Reads the source again and returns the new time. */
+uint64_t clock_refresh (void);
+
+/* Use the coarse monotonic clock if on is non-zero. */
+void clock_set_coarse (int on);
+
+/* Take time from fn instead of the system clock, or from the system
+ * clock again if fn is NULL. */
+void clock_set_source (uint64_t (*fn) (void));
+
+#endif /* CLOCK_H */
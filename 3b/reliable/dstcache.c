@@ -0,0 +1,63 @@
+#include <stdbool.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "rlib.h"
+#include "clock.h"
+#include "dstcache.h"
+
+#define DSTCACHE_SIZE	256	/* Slots, peers beyond that push each other out */
+
+struct dst_entry{
+	bool used;
+	struct sockaddr_storage addr;
+	dst_metrics m;
+};
+
+static struct dst_entry table[DSTCACHE_SIZE];
+
+const dst_metrics *dstcache_get(const struct sockaddr_storage *ss){
+	struct dst_entry *e = &table[addrhash(ss) % DSTCACHE_SIZE];
+	if(!e->used || !addreq(&e->addr, ss)){
+		return NULL;
+	}
+	return &e->m;
+}
+
+void dstcache_put(const struct sockaddr_storage *ss, const dst_metrics *m){
+	struct dst_entry *e = &table[addrhash(ss) % DSTCACHE_SIZE];
+	dst_metrics *old = &e->m;
+
+	if(!e->used || !addreq(&e->addr, ss)){
+		e->used = true;
+		e->addr = *ss;
+		e->m = *m;
+		e->m.stamp = clock_now();
+		return;
+	}
+	if(m->srtt_us >= old->srtt_us){
+		old->srtt_us = m->srtt_us;
+	} else {
+		old->srtt_us -= (old->srtt_us - m->srtt_us) / 8;
+	}
+	if(m->rttvar_us >= old->rttvar_us){
+		old->rttvar_us = m->rttvar_us;
+	} else {
+		old->rttvar_us -= (old->rttvar_us - m->rttvar_us) / 4;
+	}
+	if(m->ssthresh && old->ssthresh){
+		old->ssthresh = (old->ssthresh + m->ssthresh) / 2;
+	} else if(m->ssthresh){
+		old->ssthresh = m->ssthresh;
+	} else if(old->ssthresh && m->cwnd / 2 > old->ssthresh){
+		//no loss on the way to a window this large
+		old->ssthresh = m->cwnd / 2;
+	}
+	old->cwnd = m->cwnd;
+	if(m->rate && (m->rate < old->rate || !old->rate)){
+		old->rate = m->rate;
+	} else if(m->rate){
+		old->rate += (m->rate - old->rate) / 2;
+	}
+	old->stamp = clock_now();
+}
@@ -0,0 +1,36 @@
+#ifndef DSTCACHE_H
+#define DSTCACHE_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+/*
+ What finished connections learned about the path to a peer, kept per
+ peer address for the next connections to it, after Linux's
+ tcp_metrics.  The table is direct mapped by addrhash, so of two peers
+ that share a slot the one that finished last is remembered.  Entries
+ only ever age; how far an old one is trusted is up to the caller, see
+ cache_seed in reliable.c.
+ */
+typedef struct dst_metrics{
+	long srtt_us;			/* RTT estimate, microseconds */
+	long rttvar_us;
+	int ssthresh;			/* Packets, 0 if no loss ever cut the window */
+	int cwnd;			/* Packets, the window the connection ended with */
+	uint64_t rate;			/* Most payload bytes per second delivered over an RTT, 0 if unknown */
+	uint64_t stamp;			/* clock_now of the latest update */
+}dst_metrics;
+
+/* Returns the entry for ss, NULL if there is none. */
+const dst_metrics *dstcache_get(const struct sockaddr_storage *ss);
+
+/* Folds m, from a connection to ss that just finished, into its entry,
+ * making one if needed.  An RTT larger than the one kept replaces it
+ * and a smaller one only pulls it down by an eighth, since overestimating
+ * the RTT is the safe side; a rate is taken at once when lower and
+ * averaged in when higher, for the same reason.  The ssthresh of a
+ * connection that cut its window is averaged in, one that never did
+ * can only raise the one kept, to half its window. */
+void dstcache_put(const struct sockaddr_storage *ss, const dst_metrics *m);
+
+#endif /* DSTCACHE_H */
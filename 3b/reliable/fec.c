@@ -0,0 +1,117 @@
+#include <string.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "fec.h"
+
+/*
+ * XORs len bytes of src into dst, a word at a time.
+ */
+static void xor_into(char *dst, const char *src, int len){
+	int i = 0;
+	uint64_t a, b;
+	for(; i + 8 <= len; i += 8){
+		memcpy(&a, dst + i, 8);
+		memcpy(&b, src + i, 8);
+		a ^= b;
+		memcpy(dst + i, &a, 8);
+	}
+	for(; i < len; i++){
+		dst[i] ^= src[i];
+	}
+}
+
+void fec_add(fec_group *g, uint64_t seqno, const char *payload, int len, uint32_t flags){
+	if(!g->count){
+		g->first = seqno;
+		g->size = 0;
+		g->len = 0;
+		g->flags = 0;
+	}
+	if(len > g->size){
+		//the longer payload is XORed with zeros past the others
+		memset(g->data + g->size, 0, len - g->size);
+		g->size = len;
+	}
+	xor_into(g->data, payload, len);
+	g->len ^= len;
+	g->flags ^= flags & PKT_ZIP;
+	g->count++;
+}
+
+int fec_parity(fec_group *g, packet_t *pkt){
+	struct fec f;
+	f.count = htons(g->count);
+	f.len = htons(g->len);
+	f.flags = htonl(g->flags);
+	memcpy(pkt->data, &f, PKT_FEC_SIZE);
+	memcpy(pkt->data + PKT_FEC_SIZE, g->data, g->size);
+	g->count = 0;
+	g->first = 0;
+	return PKT_FEC_SIZE + g->size;
+}
+
+int fec_parse(fec_group *g, uint64_t first, const char *payload, int len){
+	struct fec f;
+	if(len < PKT_FEC_SIZE){
+		g->count = 0;
+		return -1;
+	}
+	memcpy(&f, payload, PKT_FEC_SIZE);
+	g->first = first;
+	g->count = ntohs(f.count);
+	g->len = ntohs(f.len);
+	g->flags = ntohl(f.flags) & PKT_ZIP;
+	g->size = len - PKT_FEC_SIZE;
+	memcpy(g->data, payload + PKT_FEC_SIZE, g->size);
+	return g->count > 0 ? 0 : -1;
+}
+
+int64_t fec_rebuild(const fec_group *g, const recvwin *w, packet_t *out){
+	uint64_t s, missing = 0;
+	const packet_t *p;
+	int hdr = offsetof(packet_t, data);
+	int len;
+	uint32_t flags;
+
+	for(s = g->first; s < g->first + g->count; s++){
+		if(recvwin_get(w, s)){
+			continue;
+		} else if(s < w->base){
+			//delivered, and its slot has been taken since
+			return -1;
+		} else if(missing){
+			return 0;
+		}
+		missing = s;
+	}
+	if(!missing){
+		return -1;
+	}
+
+	memcpy(out->data, g->data, g->size);
+	len = g->len;
+	flags = g->flags;
+	for(s = g->first; s < g->first + g->count; s++){
+		if(s == missing){
+			continue;
+		}
+		p = recvwin_get(w, s);
+		if(p->len - hdr > g->size){
+			return -1;
+		}
+		xor_into(out->data, p->data, p->len - hdr);
+		len ^= p->len - hdr;
+		flags ^= ntohl(p->rwnd) & PKT_ZIP;
+	}
+	if(len > g->size){
+		return -1;
+	}
+	out->cksum = 0;
+	out->len = hdr + len;
+	out->ackno = 0;
+	out->rwnd = htonl(flags);
+	out->seqno = (uint32_t)missing;
+	return missing;
+}
@@ -0,0 +1,44 @@
+#ifndef FEC_H
+#define FEC_H
+
+#include <stdint.h>
+
+#include "rlib.h"
+#include "recvwin.h"
+
+/*
+ XOR parity over a group of consecutive data packets, see struct fec in
+ rlib.h.  The sender adds each new data packet to its group and sends
+ the parity when the group is full; the receiver keeps the parity until
+ all but one packet of the group are at hand and rebuilds that one.
+ Seqnos are the 64-bit extended ones.
+ */
+typedef struct fec_group{
+	uint64_t first;			/* Seqno of the first packet, 0 while empty */
+	int count;			/* Packets in the group */
+	int size;			/* Longest payload */
+	uint16_t len;			/* XOR of the payload lengths */
+	uint32_t flags;			/* XOR of the PKT_ZIP flags */
+	char data[PKT_DATA_MAX];	/* XOR of the payloads */
+}fec_group;
+
+/* Adds the packet of seqno, the next after the group's last, with a
+ * payload of len bytes and flags, the PKT_ZIP it is sent with. */
+void fec_add(fec_group *g, uint64_t seqno, const char *payload, int len, uint32_t flags);
+
+/* Writes the struct fec and the XOR of g as the payload of pkt, returns
+ * its length and empties g. */
+int fec_parity(fec_group *g, packet_t *pkt);
+
+/* Takes the group back from the payload of a parity packet of len
+ * bytes, whose seqno is first.  Returns -1 if it is malformed. */
+int fec_parse(fec_group *g, uint64_t first, const char *payload, int len);
+
+/* Rebuilds the one packet of g missing from w into out, with len and
+ * seqno in host byte order as the receiver keeps them and its PKT_ZIP
+ * in rwnd.  Returns its seqno, 0 if more than one is missing, which
+ * later arrivals may change, and -1 if g is of no further use: nothing
+ * is missing, or a packet already delivered is no longer kept. */
+int64_t fec_rebuild(const fec_group *g, const recvwin *w, packet_t *out);
+
+#endif /* FEC_H */
@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "log.h"
+
+#define LOG_RING_SIZE	(1 << 16)
+#define LOG_LINE_MAX	512
+
+int log_level = LOG_WARN;
+
+/* Single producer (the logging thread), single consumer (the writer
+ * thread, or log_flush without one) */
+static char ring[LOG_RING_SIZE];
+static size_t ring_head;	/* Total bytes ever queued, by the producer */
+static size_t ring_tail;	/* Total bytes ever written out, by the consumer */
+static unsigned long dropped;
+static int registered;
+
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t wake;		/* Something was queued, or stopping */
+  pthread_t thread;
+  int running;
+  int stopping;
+} writer = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+/* Whether the consumer has anything to do */
+static int
+pending (void)
+{
+  return __atomic_load_n (&ring_head, __ATOMIC_ACQUIRE)
+    != __atomic_load_n (&ring_tail, __ATOMIC_ACQUIRE)
+    || __atomic_load_n (&dropped, __ATOMIC_RELAXED);
+}
+
+static void
+ring_write (void)
+{
+  size_t head = __atomic_load_n (&ring_head, __ATOMIC_ACQUIRE);
+  size_t tail = ring_tail;
+  unsigned long lost;
+
+  while (tail != head) {
+    size_t off = tail % LOG_RING_SIZE;
+    size_t n = head - tail;
+    ssize_t r;
+    if (n > LOG_RING_SIZE - off)
+      n = LOG_RING_SIZE - off;
+    r = write (2, ring + off, n);
+    if (r < 0) {
+      if (errno == EINTR)
+	continue;
+      /* stderr is gone or full; forget the backlog */
+      tail = head;
+      break;
+    }
+    tail += r;
+  }
+  __atomic_store_n (&ring_tail, tail, __ATOMIC_RELEASE);
+
+  lost = __atomic_exchange_n (&dropped, 0, __ATOMIC_RELAXED);
+  if (lost) {
+    char line[64];
+    int n = snprintf (line, sizeof (line), "[%lu log messages dropped]\n",
+		      lost);
+    write (2, line, n);
+  }
+}
+
+static void *
+writer_main (void *arg)
+{
+  pthread_mutex_lock (&writer.lock);
+  for (;;) {
+    while (!writer.stopping && !pending ())
+      pthread_cond_wait (&writer.wake, &writer.lock);
+    pthread_mutex_unlock (&writer.lock);
+    ring_write ();
+    pthread_mutex_lock (&writer.lock);
+    if (writer.stopping && !pending ())
+      break;
+  }
+  pthread_mutex_unlock (&writer.lock);
+  return NULL;
+}
+
+static void
+log_stop (void)
+{
+  if (!writer.running)
+    return;
+  pthread_mutex_lock (&writer.lock);
+  writer.stopping = 1;
+  pthread_cond_signal (&writer.wake);
+  pthread_mutex_unlock (&writer.lock);
+  pthread_join (writer.thread, NULL);
+  writer.running = 0;
+}
+
+void
+log_start (void)
+{
+  if (writer.running)
+    return;
+  if (pthread_create (&writer.thread, NULL, writer_main, NULL) != 0)
+    return;			/* log_flush goes on writing itself */
+  writer.running = 1;
+  atexit (log_stop);
+}
+
+void
+log_flush (void)
+{
+  int saved_errno = errno;
+  if (!writer.running)
+    ring_write ();
+  else if (pending ()) {
+    pthread_mutex_lock (&writer.lock);
+    pthread_cond_signal (&writer.wake);
+    pthread_mutex_unlock (&writer.lock);
+  }
+  errno = saved_errno;
+}
+
+void
+log_printf (int lvl, const char *fmt, ...)
+{
+  char line[LOG_LINE_MAX];
+  va_list ap;
+  int n;
+  size_t off, first;
+
+  if (!registered) {
+    registered = 1;
+    atexit (log_flush);
+  }
+
+  va_start (ap, fmt);
+  n = vsnprintf (line, sizeof (line), fmt, ap);
+  va_end (ap);
+  if (n < 0)
+    return;
+  if (n >= (int) sizeof (line))
+    n = sizeof (line) - 1;
+
+  if (ring_head - __atomic_load_n (&ring_tail, __ATOMIC_ACQUIRE) + n
+      > LOG_RING_SIZE) {
+    __atomic_add_fetch (&dropped, 1, __ATOMIC_RELAXED);
+    return;
+  }
+  off = ring_head % LOG_RING_SIZE;
+  first = LOG_RING_SIZE - off;
+  if (first > (size_t) n)
+    first = n;
+  memcpy (ring + off, line, first);
+  memcpy (ring, line + first, n - first);
+  __atomic_store_n (&ring_head, ring_head + n, __ATOMIC_RELEASE);
+
+  if (lvl <= LOG_ERROR)
+    log_flush ();
+}
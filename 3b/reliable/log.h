@@ -0,0 +1,61 @@
+#ifndef LOG_H
+#define LOG_H
+
+/* -----------------------------------------------------------------------
+
+   Leveled logging.
+
+   Messages at a level above LOG_LEVEL (set at build time, see the
+   Makefile) are compiled out entirely, arguments included.  The rest
+   are filtered at run time against log_level, which main derives from
+   the number of -d flags.
+
+   Messages are formatted into a ring buffer instead of being written
+   to stderr one by one.  Once log_start has run, a writer thread of its
+   own drains the ring, so a slow or blocked stderr never holds up the
+   event loop: conn_poll calls log_flush once per iteration, after the
+   packets have been handled, which only wakes the writer if there is
+   anything to write.  Without log_start, as in the single-threaded
+   simulator, log_flush writes the ring out itself.  Either way it is
+   drained at exit.  If the ring fills up, messages are dropped and
+   counted rather than blocking the event loop.  Only one thread may
+   log.
+
+ */
+
+#define LOG_ERROR	1
+#define LOG_WARN	2
+#define LOG_INFO	3
+#define LOG_DEBUG	4
+
+#ifndef LOG_LEVEL
+# define LOG_LEVEL LOG_INFO
+#endif /* !LOG_LEVEL */
+
+extern int log_level;		/* Highest level printed at run time */
+
+#define LOG_ON(lvl) ((lvl) <= LOG_LEVEL && (lvl) <= log_level)
+
+#define LOG(lvl, ...)							\
+  do {									\
+    if (LOG_ON (lvl))							\
+      log_printf (lvl, __VA_ARGS__);					\
+  } while (0)
+
+#define log_error(...)	LOG (LOG_ERROR, __VA_ARGS__)
+#define log_warn(...)	LOG (LOG_WARN, __VA_ARGS__)
+#define log_info(...)	LOG (LOG_INFO, __VA_ARGS__)
+#define log_debug(...)	LOG (LOG_DEBUG, __VA_ARGS__)
+
+/* Queue a message regardless of level.  Errors are flushed at once. */
+void log_printf (int lvl, const char *fmt, ...)
+  __attribute__ ((format (printf, 2, 3)));
+
+/* Write everything queued to stderr, or hand it to the writer thread
+ * once log_start has run. */
+void log_flush (void);
+
+/* Start the writer thread.  It drains what is left and exits at exit. */
+void log_start (void);
+
+#endif /* LOG_H */
@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "pcap.h"
+#include "clock.h"
+
+#define PCAP_MAGIC_NSEC	0xa1b23c4d
+#define LINKTYPE_RAW	101
+#define PCAP_BUFSIZE	(256 * 1024)
+#define PCAP_SNAPLEN	65535
+#define PCAP_FDCACHE	8
+
+struct pcap_rec {
+  uint32_t ts_sec;
+  uint32_t ts_nsec;
+  uint32_t caplen;
+  uint32_t len;
+};
+
+/* Addresses of the sockets we have seen, so getsockname and
+ * getpeername are called once per socket rather than once per packet */
+struct fd_addrs {
+  int fd;
+  struct sockaddr_storage local;
+  struct sockaddr_storage peer;
+};
+
+int pcap_enabled;
+static int pcap_fd = -1;
+static char *pcap_buf;
+static size_t pcap_used;
+static struct fd_addrs fdcache[PCAP_FDCACHE];
+static int nfdcache;
+
+static void
+put (const void *p, size_t n)
+{
+  if (pcap_used + n > PCAP_BUFSIZE)
+    pcap_flush ();
+  memcpy (pcap_buf + pcap_used, p, n);
+  pcap_used += n;
+}
+
+void
+pcap_flush (void)
+{
+  size_t off = 0;
+  int saved_errno = errno;
+
+  while (off < pcap_used) {
+    ssize_t r = write (pcap_fd, pcap_buf + off, pcap_used - off);
+    if (r < 0) {
+      if (errno == EINTR)
+	continue;
+      perror ("pcap write");
+      pcap_enabled = 0;
+      break;
+    }
+    off += r;
+  }
+  pcap_used = 0;
+  errno = saved_errno;
+}
+
+int
+pcap_open (const char *path)
+{
+  struct {
+    uint32_t magic;
+    uint16_t major, minor;
+    int32_t thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t linktype;
+  } hdr = { PCAP_MAGIC_NSEC, 2, 4, 0, 0, PCAP_SNAPLEN, LINKTYPE_RAW };
+
+  pcap_fd = open (path, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+  if (pcap_fd < 0) {
+    perror (path);
+    return -1;
+  }
+  pcap_buf = malloc (PCAP_BUFSIZE);
+  if (!pcap_buf) {
+    close (pcap_fd);
+    pcap_fd = -1;
+    return -1;
+  }
+  pcap_enabled = 1;
+  put (&hdr, sizeof (hdr));
+  atexit (pcap_flush);
+  return 0;
+}
+
+static struct fd_addrs *
+lookup (int fd)
+{
+  struct fd_addrs *a;
+  socklen_t len;
+  int i;
+
+  for (i = 0; i < nfdcache; i++)
+    if (fdcache[i].fd == fd)
+      return &fdcache[i];
+  if (nfdcache < PCAP_FDCACHE)
+    a = &fdcache[nfdcache++];
+  else
+    a = &fdcache[fd % PCAP_FDCACHE];
+  memset (a, 0, sizeof (*a));
+  a->fd = fd;
+  len = sizeof (a->local);
+  getsockname (fd, (struct sockaddr *) &a->local, &len);
+  len = sizeof (a->peer);
+  getpeername (fd, (struct sockaddr *) &a->peer, &len);
+  return a;
+}
+
+void
+pcap_forget (int fd)
+{
+  int i;
+
+  for (i = 0; i < nfdcache; i++)
+    if (fdcache[i].fd == fd) {
+      fdcache[i] = fdcache[--nfdcache];
+      return;
+    }
+}
+
+static uint32_t
+sum16 (const void *_p, size_t n, uint32_t sum)
+{
+  const uint8_t *p = _p;
+  for (; n >= 2; p += 2, n -= 2)
+    sum += p[0] << 8 | p[1];
+  if (n)
+    sum += p[0] << 8;
+  return sum;
+}
+
+static uint16_t
+fold (uint32_t sum)
+{
+  while (sum > 0xffff)
+    sum = (sum >> 16) + (sum & 0xffff);
+  return htons (~sum & 0xffff);
+}
+
+void
+pcap_packet (int fd, int out, const struct sockaddr_storage *peer,
+	     const void *buf, int n)
+{
+  struct fd_addrs *a;
+  const struct sockaddr_storage *src, *dst;
+  uint64_t now;
+  struct pcap_rec rec;
+  uint8_t ip[40];
+  size_t iplen;
+  struct {
+    uint16_t sport, dport, len, sum;
+  } udp;
+
+  if (!pcap_enabled || n < 0)
+    return;
+
+  a = lookup (fd);
+  if (!peer)
+    peer = &a->peer;
+  src = out ? &a->local : peer;
+  dst = out ? peer : &a->local;
+
+  memset (ip, 0, sizeof (ip));
+  udp.len = htons (sizeof (udp) + n);
+  udp.sum = 0;
+  if (src->ss_family == AF_INET6) {
+    const struct sockaddr_in6 *s = (const struct sockaddr_in6 *) src;
+    const struct sockaddr_in6 *d = (const struct sockaddr_in6 *) dst;
+    uint32_t sum;
+    iplen = 40;
+    ip[0] = 0x60;
+    ip[4] = (sizeof (udp) + n) >> 8;
+    ip[5] = (sizeof (udp) + n) & 0xff;
+    ip[6] = IPPROTO_UDP;
+    ip[7] = 64;
+    memcpy (ip + 8, &s->sin6_addr, 16);
+    memcpy (ip + 24, &d->sin6_addr, 16);
+    udp.sport = s->sin6_port;
+    udp.dport = d->sin6_port;
+    /* UDP over IPv6 must carry a checksum */
+    sum = sum16 (ip + 8, 32, IPPROTO_UDP + sizeof (udp) + n);
+    sum = sum16 (&udp, sizeof (udp), sum);
+    udp.sum = fold (sum16 (buf, n, sum));
+    if (!udp.sum)
+      udp.sum = 0xffff;
+  }
+  else {
+    const struct sockaddr_in *s = (const struct sockaddr_in *) src;
+    const struct sockaddr_in *d = (const struct sockaddr_in *) dst;
+    uint16_t total = 20 + sizeof (udp) + n;
+    uint16_t ck;
+    iplen = 20;
+    ip[0] = 0x45;
+    ip[2] = total >> 8;
+    ip[3] = total & 0xff;
+    ip[8] = 64;
+    ip[9] = IPPROTO_UDP;
+    memcpy (ip + 12, &s->sin_addr, 4);
+    memcpy (ip + 16, &d->sin_addr, 4);
+    ck = fold (sum16 (ip, 20, 0));
+    memcpy (ip + 10, &ck, 2);
+    udp.sport = s->sin_port;
+    udp.dport = d->sin_port;
+  }
+
+  now = clock_now ();
+  rec.ts_sec = now / NSEC_PER_SEC;
+  rec.ts_nsec = now % NSEC_PER_SEC;
+  rec.caplen = rec.len = iplen + sizeof (udp) + n;
+  put (&rec, sizeof (rec));
+  put (ip, iplen);
+  put (&udp, sizeof (udp));
+  put (buf, n);
+}
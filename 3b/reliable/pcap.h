@@ -0,0 +1,40 @@
+#ifndef PCAP_H
+#define PCAP_H
+
+#include <stddef.h>
+#include <sys/socket.h>
+
+/* -----------------------------------------------------------------------
+
+   Packet capture.
+
+   When a capture file is open, conn_sendpkt and debug_recv hand every
+   datagram to pcap_packet, which appends it to the file in pcap format
+   (nanosecond timestamps from CLOCK_MONOTONIC, raw IP link type).  Each
+   datagram is given a synthesized IPv4 or IPv6 and UDP header built from
+   the socket's addresses, so tcpdump, tshark and friends see ordinary
+   UDP traffic.  Records are collected in a buffer that is written out
+   when it fills, when the event loop goes idle, and at exit.
+
+ */
+
+/* Create (truncate) path and write the pcap header.  Returns -1 on
+ * error. */
+int pcap_open (const char *path);
+
+/* Record a datagram of n bytes sent (out != 0) or received on socket
+ * fd.  peer is the remote address, or NULL if fd is connected. */
+void pcap_packet (int fd, int out, const struct sockaddr_storage *peer,
+		  const void *buf, int n);
+
+/* Drop the cached addresses of fd before it is closed, so a socket
+ * that later reuses the descriptor is looked up afresh. */
+void pcap_forget (int fd);
+
+/* Write out whatever is buffered. */
+void pcap_flush (void);
+
+/* Non-zero when a capture file is open. */
+extern int pcap_enabled;
+
+#endif /* PCAP_H */
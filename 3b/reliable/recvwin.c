@@ -0,0 +1,141 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <sys/socket.h>
+
+#include "recvwin.h"
+
+#define RW_BIT(w, s)	((s) & ((w)->size - 1))
+
+void recvwin_init(recvwin *w, uint64_t base, uint32_t size, bool with_slots){
+	uint32_t n = 64;
+	while(n < size){
+		n <<= 1;
+	}
+	w->base = base;
+	w->size = n;
+	w->span = size;
+	w->map = xmalloc(n / 8);
+	memset(w->map, 0, n / 8);
+	w->slot = NULL;
+	w->keep = false;
+	if(with_slots){
+		w->slot = xmalloc(n * sizeof(packet_t *));
+		memset(w->slot, 0, n * sizeof(packet_t *));
+	}
+}
+
+void recvwin_free(recvwin *w){
+	uint32_t i;
+	if(w->slot){
+		for(i = 0; i < w->size; i++){
+			if(w->slot[i])
+				free(w->slot[i]);
+		}
+		free(w->slot);
+		w->slot = NULL;
+	}
+	free(w->map);
+	w->map = NULL;
+}
+
+void recvwin_slots(recvwin *w){
+	if(!w->slot){
+		w->slot = xmalloc(w->size * sizeof(packet_t *));
+		memset(w->slot, 0, w->size * sizeof(packet_t *));
+	}
+}
+
+void recvwin_keep(recvwin *w){
+	recvwin_slots(w);
+	w->keep = true;
+}
+
+bool recvwin_has(const recvwin *w, uint64_t seqno){
+	uint32_t b;
+	if(seqno - w->base >= w->size){
+		return false;
+	}
+	b = RW_BIT(w, seqno);
+	return (w->map[b / 64] >> (b % 64)) & 1;
+}
+
+int recvwin_insert(recvwin *w, uint64_t seqno, const packet_t *pkt, size_t len){
+	uint32_t b;
+	if(seqno - w->base >= w->span){
+		//already delivered or too far ahead
+		return -1;
+	}
+	b = RW_BIT(w, seqno);
+	if((w->map[b / 64] >> (b % 64)) & 1){
+		return 0;
+	}
+	if(w->slot){
+		//only as large as the packet, holes take no memory
+		packet_t *p = xmalloc(len > offsetof(packet_t, data) ? len : offsetof(packet_t, data));
+		memcpy(p, pkt, len);
+		if(w->slot[b]){
+			//kept from size seqnos back
+			free(w->slot[b]);
+		}
+		w->slot[b] = p;
+	}
+	w->map[b / 64] |= (uint64_t)1 << (b % 64);
+	return 1;
+}
+
+packet_t *recvwin_get(const recvwin *w, uint64_t seqno){
+	packet_t *p;
+	if(!w->slot){
+		return NULL;
+	}
+	if(seqno >= w->base){
+		return recvwin_has(w, seqno) ? w->slot[RW_BIT(w, seqno)] : NULL;
+	}
+	if(!w->keep || w->base - seqno > w->size){
+		return NULL;
+	}
+	//delivered, and still there unless seqno+size took the slot
+	p = w->slot[RW_BIT(w, seqno)];
+	return p && p->seqno == (uint32_t)seqno ? p : NULL;
+}
+
+packet_t *recvwin_peek(const recvwin *w){
+	if(!w->slot || !recvwin_has(w, w->base)){
+		return NULL;
+	}
+	return w->slot[RW_BIT(w, w->base)];
+}
+
+void recvwin_advance(recvwin *w){
+	uint32_t b = RW_BIT(w, w->base);
+	w->map[b / 64] &= ~((uint64_t)1 << (b % 64));
+	if(w->slot && w->slot[b] && !w->keep){
+		free(w->slot[b]);
+		w->slot[b] = NULL;
+	}
+	w->base++;
+}
+
+uint64_t recvwin_first_gap(const recvwin *w){
+	uint32_t b = RW_BIT(w, w->base);
+	uint32_t n = 0;
+	uint64_t word;
+
+	//missing seqnos are the zero bits; skip whole words of arrivals
+	word = ~w->map[b / 64] >> (b % 64);
+	if(word){
+		return w->base + __builtin_ctzll(word);
+	}
+	n = 64 - (b % 64);
+	while(n < w->size){
+		b = RW_BIT(w, w->base + n);
+		word = ~w->map[b / 64];
+		if(word){
+			n += __builtin_ctzll(word);
+			break;
+		}
+		n += 64;
+	}
+	return w->base + (n < w->size ? n : w->size);
+}
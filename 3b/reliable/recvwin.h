@@ -0,0 +1,65 @@
+#ifndef RECVWIN_H
+#define RECVWIN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "rlib.h"
+
+/*
+ Receiving window: one bit per seqno saying whether it has arrived, plus
+ (optionally) one slot per seqno holding the packet until it can be
+ delivered.  Seqno s lives at index s & (size-1), so insert, duplicate
+ detection and delivery are O(1), and only packets that actually arrive
+ use memory.  The direct write receiver uses it without slots, since
+ payloads go straight to the output file.  Seqnos are the 64-bit
+ extended ones, see seq_extend in reliable.c.  A window that keeps
+ packets holds on to them after delivery until their slot is reused, so
+ the last size seqnos stay at hand for rebuilding from parity.
+ */
+typedef struct recvwin{
+	uint64_t base;			/* Lowest seqno not yet delivered */
+	uint32_t size;			/* Number of seqnos tracked, a power of two >= 64 */
+	uint32_t span;			/* Number accepted from base on, at most size */
+	uint64_t *map;			/* Bit set when the seqno has arrived */
+	packet_t **slot;		/* Staged packets, NULL for a bitmap-only window */
+	bool keep;			/* Delivered packets stay in their slot */
+}recvwin;
+
+/* Sets up w to accept seqnos base .. base+size-1, tracking them in a
+ * bitmap, and slots, rounded up to a power of two.  If with_slots is
+ * false packets are not kept. */
+void recvwin_init(recvwin *w, uint64_t base, uint32_t size, bool with_slots);
+void recvwin_free(recvwin *w);
+
+/* Adds slots to w if it had none. */
+void recvwin_slots(recvwin *w);
+
+/* Makes w keep packets, adding slots if it had none. */
+void recvwin_keep(recvwin *w);
+
+/* Records the arrival of seqno, copying the first len bytes of pkt into
+ * its slot if the window has slots.  Returns -1 when seqno is outside
+ * the window (base .. base+span-1), 0 when it had already arrived and 1
+ * otherwise. */
+int recvwin_insert(recvwin *w, uint64_t seqno, const packet_t *pkt, size_t len);
+
+/* Returns true if seqno has arrived and not yet been delivered. */
+bool recvwin_has(const recvwin *w, uint64_t seqno);
+
+/* Returns the packet of seqno if it has arrived and is still held:
+ * not yet delivered, or delivered and kept.  NULL otherwise. */
+packet_t *recvwin_get(const recvwin *w, uint64_t seqno);
+
+/* Returns the packet at base, or NULL if it has not arrived.  Only
+ * meaningful for windows with slots. */
+packet_t *recvwin_peek(const recvwin *w);
+
+/* Forgets the packet at base (which must have arrived) and moves base
+ * up by one. */
+void recvwin_advance(recvwin *w);
+
+/* Returns the first seqno at or after base that has not arrived. */
+uint64_t recvwin_first_gap(const recvwin *w);
+
+#endif /* RECVWIN_H */
@@ -15,10 +15,53 @@
 #include <inttypes.h>
 
 #include "rlib.h"
+#include "recvwin.h"
+#include "fec.h"
+#include "zip.h"
+#include "dstcache.h"
+#include "stats.h"
+#include "log.h"
+#include "clock.h"
 
 #define ACK_HEADER_SIZE		12
 #define PKT_HEADER_SIZE		16
-#define MAX_DATA_SIZE		1000
+#define SETUP_TRIES		3	/* Rounds of HELLOs and probes before settling */
+#define IP_UDP_HEADER_SIZE	48	/* IPv6 and UDP headers, for MTU sized probes */
+#define RTO_TICKS		5	/* Retransmission timeout, in cc->timer periods */
+#define DUPTHRESH		3	/* Duplicate acks taken for a loss, at first */
+#define DUPTHRESH_MAX		64	/* Reordering raises it up to this */
+#define LIMITED_TRANSMIT	2	/* Most packets sent past the window on duplicate acks */
+#define REO_MULT_MAX		4	/* RACK reordering window, in quarter least RTTs */
+#define REO_PERSIST		16	/* Losses until it shrinks back */
+#define LINGER_MS		2000	/* Daemon: a finished connection answers resends */
+#define PEER_TIMEOUT_MS		60000	/* Daemon: a peer silent this long is gone */
+
+//Delay-based congestion control, see delay_cc
+#define BASE_HISTORY		10	/* Minutes the base RTT is remembered */
+#define CUR_FILTER		4	/* LEDBAT: current RTT is the least of this many */
+#define VEGAS_ALPHA		2	/* Vegas: grow with fewer packets queued */
+#define VEGAS_BETA		4	/* Vegas: shrink with more */
+#define VEGAS_GAMMA		1	/* Vegas: leave slow start with more */
+
+//Forward error correction, see fec_next and fec_recv
+#define FEC_GROUP_MIN		2	/* Packets per parity, at the most loss */
+#define FEC_GROUP_MAX		32	/* Packets per parity, at the least */
+#define FEC_EPOCH		64	/* Packets sent between loss rate estimates */
+#define FEC_LOSS_MIN		0.004f	/* Least loss rate FEC_AUTO sends parity at */
+#define FEC_KEEP		4	/* Parity packets the receiver holds on to */
+
+//Compression, see zip_input
+#define ZIP_CHUNK		16384	/* Input compressed, and flushed, at a time */
+#define ZIP_WORTH		90	/* Percent of its size a chunk must shrink to */
+#define ZIP_BYPASS		(1 << 20)	/* Input sent as it is after one that does not */
+#define ZIP_PACKET_CHUNKS	64	/* Most chunks one packet carries pieces of */
+#define HELLO_ZIP		HELLO_ZLIB
+
+//Peer cache, see cache_seed
+#define CACHE_TTL_MS		600000	/* Older entries are not used */
+#define CACHE_HALF_LIFE_MS	60000	/* The initial window halves as an entry ages this long */
+#define CACHE_WINDOW_MAX	128	/* Most packets of an initial window it gives */
+#define CACHE_SSTHRESH_MIN	2	/* Least ssthresh it gives */
 
 /*
  This struct will keep track of packets in our sending/receiving windows
@@ -27,58 +70,221 @@ typedef struct window_entry{
 	struct window_entry *next;			/* Linked list for traversing all windows */
 	struct window_entry *prev;
 
-	packet_t pkt;
-	struct timespec sen;
+	uint64_t seq;  //64-bit seqno, pkt.seqno holds its low 32 bits
+	uint64_t sen;  //when the packet was first sent, clock_now ns
+	uint64_t xmit;  //when it was last sent
 
 	bool valid;
-	int timeout;
+	bool retransmitted;  //no RTT sample from it once it has been resent
+	uint64_t rto_at;  //when it is resent if still unacked
+	uint32_t flags;  //PKT_ZIP if the payload is compressed
 
+	packet_t pkt;  //last, allocated only as long as the packet, see new_entry
 }window_entry;
 
 struct reliable_state{
+	rel_t *next;			/* Linked list for traversing all connections */
+	rel_t **prev;
+
 	conn_t *c;			/* This is the connection object */
 
 	/* Add your own data fields below this */
-	struct timespec start_time;
+	uint64_t start_time;
 	struct config_common *cc;
 	struct sockaddr_storage *ss;
 
 	window_entry *sending_window;
-	window_entry *receiving_window;
+	recvwin rcv;  //receiving window, base is nextSeqExpected
 
-	//Sender
-	uint32_t lastSeqAcked;
-	uint32_t lastSeqWritten;
-	uint32_t lastSeqSent;
-	uint32_t next_seqno;
+	//Sender, seqnos are 64-bit (see seq_extend)
+	uint64_t lastSeqAcked;
+	uint64_t lastSeqWritten;
+	uint64_t lastSeqSent;
+	uint64_t next_seqno;
 	bool sent_EOF;  //have we sent an EOF packet?
 	bool sender_finished;
 	int duplicate_ack_num;
+	int dupthresh;  //duplicate acks taken for a loss, see reorder_check
 
 	//Receiver
-	uint32_t nextSeqExpected;
-	uint32_t lastSeqRead;
-	uint32_t lastSeqReceived;
+	uint64_t nextSeqExpected;
+	uint64_t lastSeqRead;
+	uint64_t lastSeqReceived;
 	bool got_EOF;  //have we received an EOF packet?
 	bool receiver_finished;
+	int rcv_window;  //receiving window size given with -w
+
+	//Direct write receiver, used when the output is a regular file and
+	//HELLO_FULL is agreed
+	bool direct_write;
+	uint64_t eof_seqno;  //seqno of the EOF packet, 0 until it arrives
+	off_t rcv_end;  //end of the furthest payload written so far
 
 	int pid;
 	int sthresh;
 	float accumulator;
 	bool timeout;
+	uint64_t rto_deadline;  //no rto_at in the window is earlier, 0 if empty
+
+	//RACK-TLP (RFC 8985), see rack_detect and tlp_send
+	uint64_t rack_xmit;  //latest send time of a packet known delivered
+	uint64_t rack_deadline;  //when rack_detect looks again, 0 if not due
+	uint64_t tlp_deadline;  //when tlp_send probes the tail, 0 if not armed
+	bool tlp_out;  //a probe is out and nothing has been acked since
+	int tlp_extra;  //packets rel_read may send beyond the window for it
+
+	//Reordering, see reorder_check
+	uint64_t reo_seq;  //the hole of the latest loss cut, 0 if settled
+	uint32_t reo_ts;  //our timestamp clock at the cut
+	int reo_window;  //window before the cut, restored if it was needless
+	int reo_mult;  //RACK reordering window, in quarters of the least RTT
+	int reo_persist;  //loss cuts until reo_mult goes back to 1
+
+	//ECN, see ecn_ack
+	bool ce_pending;  //receiver: the packet about to be acked had PKT_CE
+	uint64_t ecn_recover;  //sender: no further cut until this seqno is acked
+	uint64_t dctcp_end;  //sender: last seqno of the DCTCP observation window
+	uint32_t dctcp_acked;  //packets acked in it
+	uint32_t dctcp_marked;  //of which with PKT_ECE
+	float dctcp_alpha;  //estimated fraction of packets marked
+
+	//Forward error correction, see fec_next; all unused without HELLO_FEC
+	fec_group *fec_tx;  //sender: the group being sent
+	int fec_size;  //sender: packets per group, 0 for no parity
+	float fec_loss;  //sender: loss rate estimate, for FEC_AUTO
+	uint64_t fec_holes;  //sender: first resends of the first unacked packet
+	uint64_t fec_epoch_seq;  //sender: lastSeqSent when it was last estimated
+	uint64_t fec_epoch_lost;  //sender: losses found and rebuilt by then
+	fec_group *fec_rx[FEC_KEEP];  //receiver: parity of groups not yet whole
+	int fec_rx_next;  //receiver: the entry the next parity replaces
+	bool fec_ack;  //receiver: the next ack tells a packet was rebuilt
+
+	//Compression, see zip_input; all unused unless a codec is agreed
+	zip_stream *zip_tx;  //sender
+	char *zip_raw;  //sender: input being compressed, ZIP_CHUNK bytes
+	char *raw_hold;  //sender: a short read held back, see read_raw
+	int raw_held;
+	char *zip_stage;  //sender: what it compressed to
+	int zip_len;  //sender: bytes in zip_stage
+	int zip_off;  //sender: of which already in packets
+	long zip_bypass;  //sender: input to send as it is before trying again
+	zip_stream *zip_rx;  //receiver
+	char *zip_out;  //receiver: decompressed payload, see zip_output
+	size_t zip_cap;  //its size
+	int zip_out_len;  //receiver: bytes in zip_out
+	int zip_out_off;  //of which already written
+
+	//Connection setup, see setup_send; data waits until it is over
+	bool hello_wait;  //sender: our HELLO has not been answered
+	bool probing;  //sender: our payload size probes have not settled
+	int setup_round;
+	uint64_t setup_sent;  //when the current round went out
+	uint64_t setup_deadline;  //when it is given up on, 0 if not set up
+	uint32_t features;  //HELLO_* both ends agreed on, 0 without a handshake
+	int peer_window;  //receiving window the peer announced, 0 if unknown
+
+	//Peer cache, see cache_seed and rate_sample; sender only
+	int cached_window;  //initial window it gave, 0 if none
+	bool cached_ssthresh;  //sthresh came from it, the receiver's EOF leaves it
+	uint64_t rate_start;  //when the current rate sample began, 0 before any ack
+	uint64_t rate_acked;  //bytes_acked then
+	uint64_t max_rate;  //most payload bytes per second acked over an RTT
+
+	//Daemon connections (rel_demux), see rel_finish
+	bool lingering;  //done, only acks what the peer resends
+	uint64_t expire_at;  //dropped then unless the peer is heard from, 0 if never
+	uint32_t conn_id;  //sender: sent in the HELLO; receiver: the one received, 0 if none
+	uint64_t first_hash;  //receiver: payload_hash of data packet 1, 0 until it arrives
+
+	//Timestamps, see ts_recv; all 0 unless HELLO_TS is agreed
+	uint32_t ts_recent;  //tsval to echo in the next packet sent
+	uint32_t ts_ecr;  //tsecr of the packet being processed
+	uint64_t eifel_seq;  //first seqno a timeout resent, 0 if none is in doubt
+	uint32_t eifel_ts;  //tsval its retransmission carried
+	int eifel_window;  //window the timeout cut, restored if it was spurious
+
+	//Payload size, see probe_send
+	int seg;  //payload of every data packet but the last, 0 until seqno 1 tells
+	int peer_max;  //largest payload the peer accepts, 0 until it answers
+
+	//RTT estimate in microseconds, 0 until the first sample
+	long srtt_us;
+	long rttvar_us;
+
+	//Delay-based congestion control, RTTs in microseconds
+	long base_hist[BASE_HISTORY];  //least RTT of each of the last minutes
+	int base_cur;  //entry of the current minute
+	uint64_t base_minute;  //clock_now minute base_hist[base_cur] belongs to
+	long cur_rtt[CUR_FILTER];  //LEDBAT: the latest samples
+	int cur_next;
+	long round_min_us;  //Vegas: least RTT in the current round, 0 if none
+	uint64_t round_end;  //Vegas: the round ends when this seqno is acked
+
+	stats_t stats;
 };
 rel_t *rel_list;
 
 //Method Declarations
-void process_ack(rel_t *r, packet_t* pkt);
+bool process_ack(rel_t *r, packet_t* pkt, uint64_t ackno);
 void send_ack(rel_t *r);
+void send_data(rel_t *r, window_entry *w);
+void stamp_ack(rel_t *r, packet_t *pkt, uint32_t flags);
+bool deliver(rel_t *r);
+void retransmit(rel_t *r);
+void arm_timer(rel_t *r, window_entry *w);
+void rack_detect(rel_t *r);
+void loss_cut(rel_t *r);
+void reorder_check(rel_t *r, window_entry *w, int dups);
+void tlp_arm(rel_t *r);
+void tlp_send(rel_t *r);
+int send_allowance(rel_t *r);
+uint64_t rto(rel_t *r);
+void ecn_ack(rel_t *r, uint64_t ackno, int acked, bool ece);
+void delay_cc(rel_t *r, uint64_t ackno, int acked, long us);
+long base_rtt(rel_t *r);
 
-
-int windowList_smartAdd(rel_t *r, packet_t *pkt);
 void windowList_enqueue(rel_t *r, window_entry *w, window_entry **head);
+void direct_recv(rel_t *r, packet_t *pkt, uint64_t seqno);
+bool direct_place(rel_t *r, packet_t *pkt, uint64_t seqno);
+void fec_next(rel_t *r, window_entry *w);
+void fec_send(rel_t *r);
+bool fec_recv(rel_t *r, packet_t *pkt, packet_t *out);
+uint64_t fec_repair(rel_t *r, packet_t *out);
+int read_payload(rel_t *r, char *buf, uint32_t *flags);
+int read_raw(rel_t *r, char *buf);
+int zip_input(rel_t *r, char *buf);
+bool zip_output(rel_t *r, const char *data, int n);
+bool zip_drain(rel_t *r);
+uint32_t zip_hello(int codec);
+int zip_codec(uint32_t features);
+window_entry *new_entry(int payload);
+void setup_send(rel_t *r);
+void setup_done(rel_t *r);
+void hello_send(rel_t *r, uint32_t features, int init_window);
+void hello_recv(rel_t *r, packet_t *pkt);
+uint32_t hello_features(rel_t *r);
+void probe_send(rel_t *r);
+void probe_recv(rel_t *r, packet_t *pkt);
+void probe_done(rel_t *r);
+int send_max(rel_t *r);
+int recv_max(rel_t *r);
+uint64_t seq_extend(uint64_t ref, uint32_t wire);
+uint32_t ts_now(void);
+int ts_stamp(rel_t *r, packet_t *pkt, int len);
+void ts_recv(rel_t *r, packet_t *pkt);
 window_entry* windowList_dequeue(rel_t *r, window_entry **head);
 void printPacket(packet_t *pkt, rel_t *r);
 void time_out(rel_t *r);
+long rtt_sample(rel_t *r, uint64_t sen);
+void write_stats(rel_t *r);
+void rel_finish(rel_t *r);
+bool opens_connection(packet_t *pkt, size_t n);
+bool same_connection(rel_t *r, packet_t *pkt, size_t n);
+uint64_t payload_hash(const packet_t *pkt, size_t n);
+uint32_t conn_id_new(void);
+void cache_seed(rel_t *r);
+void cache_store(rel_t *r);
+void rate_sample(rel_t *r);
 
 
 
@@ -104,27 +310,30 @@ rel_t * rel_create (conn_t *c, const struct sockaddr_storage *ss,
 
 	r->c = c;
 
-	rel_list = r;
 	r->timeout = false;
 
-	//Allocate ss and cc, exactly one should be NULL
+	//Allocate ss, which only rel_demux gives, and cc
 	if(ss){
 		r->ss = xmalloc(sizeof(struct sockaddr_storage));
 		memcpy(r->ss,ss,sizeof(struct sockaddr_storage));
-		cc = NULL;
-	} else if(cc){
-		r->cc = xmalloc(sizeof(struct config_common));
-		memcpy(r->cc,cc,sizeof(struct config_common));
-		ss = NULL;
-	} else{
-		return NULL;
+		r->expire_at = clock_now() + PEER_TIMEOUT_MS * NSEC_PER_MSEC;
 	}
+	r->cc = xmalloc(sizeof(struct config_common));
+	memcpy(r->cc,cc,sizeof(struct config_common));
+
+	r->next = rel_list;
+	r->prev = &rel_list;
+	if(rel_list)
+		rel_list->prev = &r->next;
+	rel_list = r;
 
 	r->next_seqno = 1;
 
+	r->rcv_window = r->cc->window;
+
 	//Slow Start
 	r->sthresh = r->cc->window/2;
-	fprintf(stderr, "Threshold = %d", r->sthresh);
+	log_info("Threshold = %d\n", r->sthresh);
 	r->cc->window = 1;
 
 	//Congestion avoidance
@@ -132,24 +341,41 @@ rel_t * rel_create (conn_t *c, const struct sockaddr_storage *ss,
 
 	//Initialize the window
 	r->sending_window = NULL;
-	r->receiving_window = NULL;
 
 	//Sender
 	r->lastSeqAcked = 0;
 	r->lastSeqWritten = 0;
 	r->lastSeqSent = 0;
 	r->duplicate_ack_num = 1;
+	r->dupthresh = r->cc->dupthresh ? r->cc->dupthresh : DUPTHRESH;
+	r->reo_mult = 1;
 
 	//Receiver
 	r->nextSeqExpected = 1;
 	r->lastSeqRead = 0;
 	r->lastSeqReceived = 0;
+	//until data comes without HELLO_FULL, see rel_recvpkt
+	r->direct_write = r->c->sender_receiver == RECEIVER && conn_output_seekable(r->c);
+	//the direct write receiver keeps no packets, only the bitmap
+	recvwin_init(&r->rcv, r->nextSeqExpected, r->rcv_window, !r->direct_write);
+
+	//Features only once the receiver agrees, and larger payloads only
+	//once probes of them get through and timestamps are on, see setup_done
+	r->seg = PKT_DATA_BASE;
+	if(r->c->sender_receiver == SENDER){
+		cache_seed(r);
+		r->conn_id = conn_id_new();
+		r->hello_wait = hello_features(r) || r->cc->init_window > 1;
+		r->probing = r->cc->timestamps && send_max(r) > r->seg;
+		if(r->hello_wait || r->probing)
+			setup_send(r);
+	}
 
 	r->pid = getpid();
 
 	/* Do any other initialization you need here */
 	//Initialize timer
-	clock_gettime(CLOCK_MONOTONIC,&r->start_time);
+	r->start_time = clock_now();
 	if(r->c->sender_receiver == RECEIVER)
 	{
 		rel_read (r);
@@ -158,10 +384,12 @@ rel_t * rel_create (conn_t *c, const struct sockaddr_storage *ss,
 }
 
 void rel_destroy (rel_t *r){
-	//Manage linked list
-	struct timespec end_time;
-	clock_gettime(CLOCK_MONOTONIC,&end_time);
-	fprintf(stderr, "File transfer was of %ld milliseconds\n",(end_time.tv_nsec - r->start_time.tv_nsec)/(long)(1000000));
+	write_stats(r);
+	cache_store(r);
+
+	if(r->next)
+		r->next->prev = r->prev;
+	*r->prev = r->next;
 
 	conn_destroy (r->c);
 
@@ -178,17 +406,17 @@ void rel_destroy (rel_t *r){
 		free(temp_entry);
 	}
 
-	
-	temp_entry = r->receiving_window;
-	if(temp_entry!=NULL){
-		
-		while(temp_entry->next != NULL){
-			//free(temp_entry->pkt);
-			temp_entry = temp_entry->next;
-			free(temp_entry->prev);
-		}
-		free(temp_entry);
-	}
+	recvwin_free(&r->rcv);
+	free(r->fec_tx);
+	int i;
+	for(i = 0; i < FEC_KEEP; i++)
+		free(r->fec_rx[i]);
+	zip_free(r->zip_tx);
+	zip_free(r->zip_rx);
+	free(r->zip_raw);
+	free(r->raw_hold);
+	free(r->zip_stage);
+	free(r->zip_out);
 
 	//Don't worry about the connection, rlib frees the connection pointer.
 	if(r->ss)
@@ -196,8 +424,97 @@ void rel_destroy (rel_t *r){
 	if(r->cc)
 		free(r->cc);
 	free(r);
-	exit(EXIT_SUCCESS);
+	//rlib returns from main once the output has drained, or the daemon
+	//goes on with its other connections
+}
+
+/*
+ * Ends r once both directions are done.  In stand-alone mode it goes
+ * right away.  A daemon connection lingers for LINGER_MS, acking what
+ * its peer resends in case the last ack was lost, the way TCP's
+ * TIME_WAIT does, unless a new connection from the same address
+ * replaces it first (see rel_demux).
+ */
+void rel_finish(rel_t *r){
+	if(!r->ss){
+		rel_destroy(r);
+		return;
+	}
+	log_info("Connection done, lingering\n");
+	r->lingering = true;
+	r->rto_deadline = 0;
+	r->rack_deadline = 0;
+	r->tlp_deadline = 0;
+	r->expire_at = clock_now() + LINGER_MS * NSEC_PER_MSEC;
+}
+
+/*
+ * Returns true if pkt, as it came off the network, opens a connection:
+ * a HELLO, a payload size probe or data packet 1, with a good checksum.
+ */
+bool opens_connection(packet_t *pkt, size_t n){
+	uint16_t sum = pkt->cksum;
+	bool good;
+	if(n < PKT_HEADER_SIZE || ntohs(pkt->len) != n)
+		return false;
+	pkt->cksum = 0;
+	good = cksum((void*)pkt, (int)n) == sum;
+	pkt->cksum = sum;
+	return good && ((ntohl(pkt->rwnd) & (PKT_HELLO | PKT_PROBE))
+		|| ntohl(pkt->seqno) == 1);
+}
+
+/*
+ * Returns true if pkt, which opens a connection, comes from the
+ * connection r already has with its peer rather than a new one: a
+ * HELLO with the connection id r got (none for both if the peer
+ * predates ids), a payload size probe, or data packet 1 with the
+ * payload r's had.  A resent packet 1 may carry another timestamp or
+ * piggybacked ack, so only the payload counts.
+ */
+bool same_connection(rel_t *r, packet_t *pkt, size_t n){
+	uint32_t flags = ntohl(pkt->rwnd);
+	struct hello h;
+	if(flags & PKT_HELLO){
+		memset(&h, 0, sizeof(h));
+		memcpy(&h, pkt->data, n - PKT_HEADER_SIZE < sizeof(h) ? n - PKT_HEADER_SIZE : sizeof(h));
+		return ntohl(h.conn_id) == r->conn_id;
+	}
+	if(flags & PKT_PROBE){
+		//its HELLO decides, or packet 1 if it has none
+		return true;
+	}
+	return payload_hash(pkt, n) == r->first_hash;
+}
+
+/*
+ * FNV-1a hash of the payload of pkt, as it came off the network and n
+ * bytes long, leaving out any timestamp trailer.  Never 0.
+ */
+uint64_t payload_hash(const packet_t *pkt, size_t n){
+	uint64_t h = 0xcbf29ce484222325ULL;
+	size_t i;
+	if(ntohl(pkt->rwnd) & PKT_TS)
+		n = n >= PKT_HEADER_SIZE + PKT_TS_SIZE ? n - PKT_TS_SIZE : PKT_HEADER_SIZE;
+	for(i = PKT_HEADER_SIZE; i < n; i++){
+		h ^= ((const unsigned char *)pkt)[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h ? h : 1;
+}
 
+/*
+ * Draws the id a sender puts in its HELLO, different for every
+ * connection of the process and, by the clock and pid, likely of any
+ * other.  Never 0, which stands for none.
+ */
+uint32_t conn_id_new(void){
+	static uint32_t conns;
+	uint64_t x = clock_now() ^ ((uint64_t)getpid() << 32) ^ ++conns;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return (uint32_t)x ? (uint32_t)x : 1;
 }
 
 
@@ -212,10 +529,32 @@ void rel_destroy (rel_t *r){
 void rel_demux (const struct config_common *cc,
 		const struct sockaddr_storage *ss,
 		packet_t *pkt, size_t len){
+	rel_t *r;
+	bool opens = opens_connection(pkt, len);
+	for(r = rel_list; r; r = r->next){
+		if(r->ss && addreq(r->ss, ss))
+			break;
+	}
+	if(r && (r->lingering || r->got_EOF) && opens && !same_connection(r, pkt, len)){
+		//a new connection from a peer whose last has sent all it had,
+		//even if the ack for our EOF has not come yet; resends of the
+		//last still go to it, to be acked again
+		rel_destroy(r);
+		r = NULL;
+	}
+	if(!r && opens)
+		r = rel_create(NULL, ss, cc);
+	//anything else from an unknown peer belongs to a connection long gone
+	if(!r)
+		return;
+	if(opens && !r->first_hash && !(ntohl(pkt->rwnd) & (PKT_HELLO | PKT_PROBE)))
+		r->first_hash = payload_hash(pkt, len);
+	rel_recvpkt(r, pkt, len);
 }
 
 void rel_recvpkt (rel_t *r, packet_t *pkt, size_t n){
-	printPacket(pkt, r);
+	if(LOG_ON(LOG_DEBUG))
+		printPacket(pkt, r);
 	// Check packet formation
 	if ((size_t) ntohs(pkt->len) < n){
 		return;
@@ -225,7 +564,7 @@ void rel_recvpkt (rel_t *r, packet_t *pkt, size_t n){
 	memset(&(pkt->cksum),0,sizeof(pkt->cksum));
 
 	if( cksum((void*)pkt, (int)n) != received_checksum){
-		fprintf(stderr, "BAD CHECKSUM");
+		log_warn("BAD CHECKSUM\n");
 		return;
 	}
 	// enforce host byte order
@@ -234,23 +573,107 @@ void rel_recvpkt (rel_t *r, packet_t *pkt, size_t n){
 
 	if((int)pkt->len != n) return; //the length doesn't match
 
+	if(r->ss){
+		//the daemon drops connections whose peer has gone quiet
+		r->expire_at = clock_now() + (r->lingering ? LINGER_MS : PEER_TIMEOUT_MS) * NSEC_PER_MSEC;
+	}
+	if(r->lingering){
+		//only resends come now, the ack for them must have been lost
+		if(pkt->len > ACK_HEADER_SIZE)
+			send_ack(r);
+		return;
+	}
+
+	r->ts_ecr = 0;
+	if(ntohl(pkt->rwnd) & PKT_TS){
+		if(pkt->len < ACK_HEADER_SIZE + PKT_TS_SIZE)
+			return;
+		ts_recv(r, pkt);
+	}
+
 	// make sure packet length is valid.
 	if (pkt->len > ACK_HEADER_SIZE){
 		pkt->seqno = ntohl(pkt->seqno);
-	}else if(pkt->len < ACK_HEADER_SIZE || pkt->len > (MAX_DATA_SIZE+PKT_HEADER_SIZE)){
-		fprintf(stderr, "Got packet of invalid size.\n");
+	}else if(pkt->len < ACK_HEADER_SIZE || pkt->len > (PKT_DATA_MAX+PKT_HEADER_SIZE)){
+		log_warn("Got packet of invalid size.\n");
+		return;
+	}
+
+	if(ntohl(pkt->rwnd) & PKT_PROBE){
+		probe_recv(r, pkt);
+		return;
+	}
+	if(ntohl(pkt->rwnd) & PKT_HELLO){
+		hello_recv(r, pkt);
 		return;
 	}
+	if((r->hello_wait || r->probing) && pkt->len == ACK_HEADER_SIZE){
+		//a peer without the handshake or probes acks them as duplicates
+		r->hello_wait = false;
+		probe_done(r);
+	}
+	packet_t rebuilt;
+	if(pkt->len > ACK_HEADER_SIZE && (ntohl(pkt->rwnd) & PKT_FEC)){
+		//parity goes on as the packet it rebuilds, if any
+		if(!fec_recv(r, pkt, &rebuilt))
+			return;
+		pkt = &rebuilt;
+	}
+
+	if (pkt->len > ACK_HEADER_SIZE){
+		//echoed in the ack this packet triggers
+		r->ce_pending = (ntohl(pkt->rwnd) & PKT_CE) != 0;
+		if(r->ce_pending)
+			r->stats.ce_rcvd++;
+	}
 
 	// Do some stuff with the packets
-	// Start by looking for Acks
+	// Start by looking for Acks, which data packets carry too (ackno 0
+	// from a peer that does not piggyback)
+	if (pkt->len == ACK_HEADER_SIZE || pkt->ackno != 0){
+		if(process_ack(r, pkt, seq_extend(r->lastSeqAcked + 1, pkt->ackno)))
+			return;
+	}
 	if (pkt->len == ACK_HEADER_SIZE){
-		process_ack(r,pkt);
+		rel_read(r);
+		return;
+	}
+	uint64_t seqno = seq_extend(r->nextSeqExpected, pkt->seqno);
+	if(!r->seg && seqno == 1){
+		//the sender probed, so the payload size is what seqno 1 carries
+		r->seg = pkt->len > PKT_HEADER_SIZE ? pkt->len - PKT_HEADER_SIZE : PKT_DATA_BASE;
+	}
+	if(r->direct_write && !(r->features & HELLO_FULL)){
+		//payloads may be short anywhere, so seqnos do not say where
+		//they go in the output
+		r->direct_write = false;
+		recvwin_slots(&r->rcv);
+	}
+	if(r->direct_write){
+		direct_recv(r, pkt, seqno);
 	}else{
 		// must be data if it's not corrupted and not an ACK
-		windowList_smartAdd(r,pkt);
-		rel_output(r);
-		send_ack(r);
+		int added = r->got_EOF ? 0 : recvwin_insert(&r->rcv, seqno, pkt, pkt->len);
+		r->stats.pkts_rcvd++;
+		if(added < 0 && seqno >= r->nextSeqExpected){
+			//ignore packet that is too far ahead
+			log_info("Package of seqno %" PRIu64 " was not added. Far ahead.\n", seqno);
+		} else if(added <= 0){
+			r->stats.dup_pkts++;
+		}
+		//parity that was waiting on this packet
+		uint64_t seq;
+		while(!r->got_EOF && (seq = fec_repair(r, &rebuilt)))
+			recvwin_insert(&r->rcv, seq, &rebuilt, rebuilt.len);
+		if(deliver(r))
+			return;
+		//data leaving now carries the ack, only send one on its own if none does
+		uint64_t sent = r->stats.pkts_sent;
+		rel_read(r);
+		if(r->stats.pkts_sent == sent)
+			send_ack(r);
+		else
+			r->stats.acks_piggybacked++;
 	}
 }
 
@@ -265,37 +688,28 @@ void rel_read (rel_t *r){
 			return;
 		}
 		else {
-			fprintf(stderr, "Added EOF to window");
-			packet_t packet;
-			window_entry *window = (window_entry *)xmalloc(sizeof(window_entry));
-			int packet_size = PKT_HEADER_SIZE;
+			log_info("Added EOF to window\n");
+			window_entry *window = new_entry(0);
 			//EOF packet has no data but has seqno
-			packet.seqno = htonl(r->next_seqno); r->next_seqno++;
-			packet.len = htons(packet_size);
-			packet.ackno=htonl(0);
-			packet.rwnd = htonl(r->cc->window);
-			memset(&(packet.cksum),0,sizeof(uint16_t));
-			packet.cksum=cksum((void*)&packet,PKT_HEADER_SIZE);
-			//save packet in window entry
-			memcpy(&window->pkt,&packet,sizeof(packet_t));
+			window->seq = r->next_seqno++;
+			window->pkt.seqno = window->seq;
+			window->pkt.len = PKT_HEADER_SIZE;
 			window->valid=true;
-			window->timeout = 0;
+			window->retransmitted = false;
+			window->flags = 0;
 			r->sent_EOF = true;
 			//update window parameters
-			r->lastSeqWritten = htonl(window->pkt.seqno);
+			r->lastSeqWritten = window->seq;
 			
 			//send packet?
-			conn_sendpkt(r->c, &window->pkt, packet_size);
-			
-			//Decode to host before enqueue
-			window->pkt.len = ntohs (window->pkt.len);
-			window->pkt.ackno = ntohl (window->pkt.ackno);
-			window->pkt.seqno = ntohl(window->pkt.seqno);
+			window->sen = clock_now();
+			arm_timer(r, window);
+			send_data(r, window);
 			
 			//enqueue
 			windowList_enqueue(r, window, &r->sending_window);
 			
-			r->lastSeqSent = htonl(window->pkt.seqno);
+			r->lastSeqSent = window->seq;
 
 		}
 	}
@@ -303,150 +717,259 @@ void rel_read (rel_t *r){
 	{
 		int bytes_read = 0;
 		int window_size = r->lastSeqWritten - r->lastSeqAcked;
+		int allowed = send_allowance(r);
 		packet_t packet;
-		memset(&(packet.data),0,MAX_DATA_SIZE);
-		uint32_t packet_size = 0;
+		uint32_t flags;
 
 		while(1){
 			//Check if we can create a new window entry
-			if(window_size > r->cc->window || window_size<0){
-				fprintf(stderr,"ERROR: Window size greater than maximum permitted window size or negative");
+			if(r->sent_EOF || r->setup_deadline){
+				//Nothing left to send, or not yet
+				return;
+			}else if(r->peer_window && window_size >= r->peer_window){
+				//the receiver has no room for more
 				return;
-			}else if (window_size == r->cc->window){
+			}else if(window_size > allowed || window_size<0){
+				log_debug("Window size greater than maximum permitted window size or negative\n");
+				return;
+			}else if (window_size == allowed){
 				//Window is full!
 				return;
-			}else if((bytes_read = conn_input(r->c, packet.data, MAX_DATA_SIZE)) == 0){
-				//Nothing to read
+			}else if((bytes_read = read_payload(r, packet.data, &flags)) == 0){
+				//Nothing to read, so the group is as full as it gets for now
+				if(r->fec_tx && r->fec_tx->count >= FEC_GROUP_MIN)
+					fec_send(r);
 				return;
 			}
-			//Valid packet
-			window_entry *window = (window_entry *)xmalloc(sizeof(window_entry));
-
 			if(bytes_read<0){ // EOF reached
-				packet_size = PKT_HEADER_SIZE;
 				//EOF packet has no data but has seqno
-				packet.seqno = htonl(r->next_seqno); r->next_seqno++;
-				packet.len = htons(packet_size);
-				packet.ackno=htonl(0);
-				memset(&(packet.cksum),0,sizeof(uint16_t));
-				packet.cksum=cksum((void*)&packet,PKT_HEADER_SIZE);
-				//save packet in window entry
-				memcpy(&window->pkt,&packet,sizeof(packet_t));
-				window->valid=true;
-				window->timeout = 0;
+				bytes_read = 0;
 				r->sent_EOF = true;
-			}else{
-				//make a normal packet and add it to the window
-				packet_size = PKT_HEADER_SIZE + bytes_read;
-				packet.seqno = htonl(r->next_seqno); r->next_seqno++;
-				packet.len = htons(packet_size);
-				packet.ackno=htonl(0);
-				memset(&(packet.cksum),0,sizeof(uint16_t));
-				packet.cksum=cksum((void*)&packet,packet_size);
-				//save packet in window entry
-				memcpy(&window->pkt,&packet,sizeof(packet_t));
-				window->valid=true;
-				window->timeout = 0;
 			}
+			//Valid packet
+			window_entry *window = new_entry(bytes_read);
+
+			//make a packet, kept in host byte order, and add it to the window
+			memcpy(window->pkt.data, packet.data, bytes_read);
+			window->seq = r->next_seqno++;
+			window->pkt.seqno = window->seq;
+			window->pkt.len = PKT_HEADER_SIZE + bytes_read;
+			window->valid=true;
+			window->retransmitted = false;
+			window->flags = flags;
 			//update window parameters
-			r->lastSeqWritten = htonl(window->pkt.seqno);
+			r->lastSeqWritten = window->seq;
 
 			//send packet?
-			conn_sendpkt(r->c, &window->pkt, packet_size);
-
-			//Decode to host before enqueue
-			window->pkt.len = ntohs (window->pkt.len);
-			window->pkt.ackno = ntohl (window->pkt.ackno);
-			window->pkt.seqno = ntohl(window->pkt.seqno);
+			window->sen = clock_now();
+			arm_timer(r, window);
+			send_data(r, window);
 
 			//enqueue
 			windowList_enqueue(r, window, &r->sending_window);
 
-			r->lastSeqSent = htonl(window->pkt.seqno);
+			r->lastSeqSent = window->seq;
 			window_size = r->lastSeqWritten - r->lastSeqAcked;
+			if(r->fec_tx)
+				fec_next(r, window);
+			tlp_arm(r);
 
 		}
 	}
 }
 
 void rel_output (rel_t *r){
-	window_entry *traverse = r->receiving_window;
-	while(traverse != NULL){
-		if(!traverse->valid){break;}
-		else if(conn_bufspace(r->c) >= traverse->pkt.len - PKT_HEADER_SIZE){
-
-			//commit the data
-			if(!r->got_EOF){
-				conn_output(r->c,(void*)(traverse->pkt.data),traverse->pkt.len - PKT_HEADER_SIZE);
-				fprintf(stderr, "Out %d @ %d\n", traverse->pkt.seqno, getpid());
-			}
+	deliver(r);
+}
 
-			//was the pkt an EOF?
-			if(traverse->pkt.len == PKT_HEADER_SIZE){
-				//received an EOF packet
-				r->got_EOF = true;
-				fprintf(stderr, "GOT EOF at rel_output!\n");
-				if(r->c->sender_receiver != RECEIVER){
-					r->receiver_finished = true;
-					r->sthresh = (traverse->pkt.rwnd)/2;
-				}
-				if(r->sender_finished) {
-					rel_destroy(r);
-					return;
-				}
+/*
+ * Hands the packets at the front of the receiving window to the output.
+ * Returns true if that finished the connection, see rel_finish.
+ */
+bool deliver(rel_t *r){
+	if(r->direct_write){
+		//payloads were written as they arrived, nothing is queued
+		return false;
+	}
+	packet_t *pkt;
+	while((pkt = recvwin_peek(&r->rcv)) != NULL){
+		int payload = pkt->len - PKT_HEADER_SIZE;
+
+		//commit the data
+		if(payload && (ntohl(pkt->rwnd) & PKT_ZIP)){
+			//decompressed once, then written as the output makes room;
+			//the packet stays in the window until all of it is
+			if(r->zip_out_off == r->zip_out_len && !zip_output(r, pkt->data, payload)){
+				//the rest of the stream cannot be decoded either
+				if(r->cc->single_connection)
+					exit(1);
+				rel_destroy(r);
+				return true;
+			}
+			if(!zip_drain(r)){
+				log_debug("BUFFER FULL\n");
+				break;
+			}
+		} else {
+			if(conn_bufspace(r->c) < payload){
+				log_debug("BUFFER FULL\n");
 				break;
 			}
+			conn_output(r->c,(void*)(pkt->data),payload);
+			r->stats.bytes_delivered += payload;
+		}
+		log_debug("Out %d @ %d\n", pkt->seqno, r->pid);
+
+		//was the pkt an EOF?
+		if(payload == 0){
+			//received an EOF packet
+			r->got_EOF = true;
+			log_info("GOT EOF at rel_output!\n");
+			if(r->c->sender_receiver != RECEIVER){
+				r->receiver_finished = true;
+				if(!r->cached_ssthresh)
+					r->sthresh = (ntohl(pkt->rwnd) & RWND_MASK)/2;
+			}
+			recvwin_advance(&r->rcv);
+			r->nextSeqExpected = r->rcv.base;
+			if(r->sender_finished) {
+				send_ack(r);
+				rel_finish(r);
+				return true;
+			}
+			break;
+		}
 
-			traverse=traverse->next;
-			r->nextSeqExpected++; //update the next expected sequence number
+		//slide the window - delete the newly written packet
+		recvwin_advance(&r->rcv);
+		r->nextSeqExpected = r->rcv.base; //update the next expected sequence number
+	}
+	return false;
+}
 
-			window_entry *fetch = windowList_dequeue(r, &r->receiving_window); //slide the window - delete the newly written packet
-			if(fetch != NULL){
-				free(fetch);
-			} else{fprintf(stderr, "ERROR: COULD NOT FREE!\n");}
-		} else{
-			fprintf(stderr, "BUFFER FULL\n");
+void rel_timer(){
+	rel_t *curr, *next;
+	uint64_t now = clock_now();
+	for(curr = rel_list; curr; curr = next){
+		next = curr->next;
+		if(curr->expire_at && curr->expire_at <= now){
+			if(!curr->lingering)
+				log_warn("Peer went quiet, connection dropped\n");
+			rel_destroy(curr);
+			continue;
+		}
+		if(curr->rto_deadline && curr->rto_deadline <= now)
+			retransmit(curr);
+		if(curr->rack_deadline && curr->rack_deadline <= now)
+			rack_detect(curr);
+		if(curr->tlp_deadline && curr->tlp_deadline <= now)
+			tlp_send(curr);
+		if(curr->setup_deadline && curr->setup_deadline <= now){
+			if(++curr->setup_round < SETUP_TRIES){
+				setup_send(curr);
+			} else {
+				//go on with whatever was answered
+				curr->hello_wait = false;
+				probe_done(curr);
+			}
 		}
 	}
 }
 
-void rel_timer(){
-	rel_t *curr = rel_list;
-	window_entry *curr_win = rel_list->sending_window;
+/*
+ * Returns the earliest time rel_timer has something to do, 0 if there is
+ * nothing in flight.  rlib sleeps until then.
+ */
+uint64_t rel_next_deadline(void){
+	rel_t *curr;
+	uint64_t deadline = 0;
+	for(curr = rel_list; curr; curr = curr->next){
+		if(curr->rto_deadline && (!deadline || curr->rto_deadline < deadline))
+			deadline = curr->rto_deadline;
+		if(curr->setup_deadline && (!deadline || curr->setup_deadline < deadline))
+			deadline = curr->setup_deadline;
+		if(curr->rack_deadline && (!deadline || curr->rack_deadline < deadline))
+			deadline = curr->rack_deadline;
+		if(curr->tlp_deadline && (!deadline || curr->tlp_deadline < deadline))
+			deadline = curr->tlp_deadline;
+		if(curr->expire_at && (!deadline || curr->expire_at < deadline))
+			deadline = curr->expire_at;
+	}
+	return deadline;
+}
+
+/*
+ * Resends the packets of r whose retransmission timeout has expired, and
+ * finds the next one to expire.  The first unacked packet goes out with
+ * them, first, if its own timer would expire within a timer period:
+ * resent on its own just after such a burst it could find the
+ * bottleneck queue full each time, and nothing behind it can be acked
+ * before it is.
+ */
+void retransmit(rel_t *curr){
+	window_entry *curr_win = curr->sending_window;
+	uint64_t now = clock_now();
+	curr->rto_deadline = 0;
+	for(; curr_win; curr_win = curr_win->next){
+		if(curr_win->valid && curr_win->rto_at <= now){
+			if(curr->sending_window->rto_at <= now + curr->cc->timer * NSEC_PER_MSEC)
+				curr->sending_window->rto_at = now;
+			break;
+		}
+	}
+	curr_win = curr->sending_window;
 	while(curr_win){
-		if(curr_win->valid && curr_win->timeout >=5){
+		if(curr_win->valid && curr_win->rto_at <= now){
+			int before = curr->cc->window;
+			if(curr_win == curr->sending_window && !curr_win->retransmitted)
+				curr->fec_holes++;
 			time_out(curr);
+			if(curr->cc->window != before && (curr->features & HELLO_TS)){
+				//Eifel (RFC 3522): undone if the first ack for it echoes
+				//an earlier transmission
+				curr->eifel_seq = curr_win->seq;
+				curr->eifel_ts = ts_now();
+				curr->eifel_window = before;
+			}
 
-			packet_t packet;
-			memcpy(&packet, &curr_win->pkt, sizeof(packet_t));
-			packet.len = htons(packet.len);
-			packet.seqno = htonl(packet.seqno);
-			packet.ackno = htonl(packet.ackno);
-			curr_win->timeout = 0;
-			conn_sendpkt(curr->c, &packet, curr_win->pkt.len); //send it
+			curr_win->retransmitted = true;
+			curr_win->rto_at = now + rto(curr);
+			send_data(curr, curr_win); //send it
+			curr->stats.retransmits++;
+			curr->stats.timeouts++;
 		}
-		curr_win->timeout++;
+		if(!curr->rto_deadline || curr_win->rto_at < curr->rto_deadline)
+			curr->rto_deadline = curr_win->rto_at;
 
 		curr_win = curr_win->next;
 	}
-
-
 }
 
 /*
  * Processes Acks server side, frees up the window depending on the ack.
- * Ignores Acks not in window. Updates lastSeqAcked.
+ * Ignores Acks not in window. Updates lastSeqAcked.  pkt may be a data
+ * packet, whose ack is never counted as a duplicate.  Returns true if
+ * that finished the connection, see rel_finish.
  */
-void process_ack(rel_t *r, packet_t* pkt){
+bool process_ack(rel_t *r, packet_t* pkt, uint64_t ackno){
 	//check if packet is in window
-	uint32_t ackno = pkt->ackno;
-	if(ackno < r->lastSeqAcked || r->lastSeqSent<ackno){
-		fprintf(stderr, "INFO: received ack for %d seqno, not in window %d - %d\n",pkt->ackno,r->lastSeqAcked,r->lastSeqAcked+r->cc->window);
+	uint64_t sen = 0;
+	bool have_sample = false;
+	int acked = 0;
+	int dups = r->duplicate_ack_num - 1;
+	//a loss all the same, which the window answers for once
+	bool rebuilt = pkt->len == ACK_HEADER_SIZE && (ntohl(pkt->rwnd) & PKT_FEC);
+	bool cut = false;
+	r->stats.acks_rcvd++;
+	if(ackno < r->lastSeqAcked || r->lastSeqSent+1<ackno){
+		log_info("received ack for %" PRIu64 " seqno, not in window %" PRIu64 " - %" PRIu64 "\n",
+			ackno, r->lastSeqAcked, r->lastSeqAcked + r->cc->window);
 	}
-	if (ackno - 1 == r->lastSeqAcked){
+	if (pkt->len == ACK_HEADER_SIZE && ackno - 1 == r->lastSeqAcked){
+		r->stats.dup_acks++;
 		r->duplicate_ack_num++;
-		if (r->duplicate_ack_num >= 3){
-			time_out(r);
+		if (r->duplicate_ack_num - 1 >= r->dupthresh){
+			loss_cut(r);
 		}
 	}
 	else{
@@ -455,56 +978,1056 @@ void process_ack(rel_t *r, packet_t* pkt){
 
 	//seqno in flush packets
 	window_entry *current = r->sending_window;
-	while(current!=NULL && current->pkt.seqno<ackno && ackno<=r->lastSeqSent){
+	while(current!=NULL && current->seq<ackno && ackno<=r->lastSeqSent+1){
 		current = windowList_dequeue(r, &r->sending_window);
 		if(current!=NULL){
-			fprintf(stderr, "Freeing %d window %d\n", current->pkt.seqno, r->cc->window+1);
+			log_debug("Freeing %" PRIu64 " window %d\n", current->seq, r->cc->window+1);
+			r->stats.bytes_acked += current->pkt.len - PKT_HEADER_SIZE;
+			//Karn: only time the newest packet, and only if never resent
+			have_sample = !current->retransmitted;
+			sen = current->sen;
+			if(have_sample && sen > r->rack_xmit)
+				r->rack_xmit = sen;
+			if(current->seq == r->reo_seq && rebuilt){
+				//lost, so the duplicate acks' cut stands
+				r->reo_seq = 0;
+				cut = true;
+			} else if(current->seq == r->reo_seq){
+				reorder_check(r, current, dups);
+			}
 			free(current);
+			acked++;
 			//Calcualte the window size
 			if(r->sthresh>r->cc->window){
 				//Grow window exponentially!
 				r->cc->window++;
 				r->timeout = false;
-			} else {
+			} else if(r->cc->cc_algo == CC_AIMD){
 				//Grow slowly
-				r->accumulator += 1/r->cc->window;
+				r->accumulator += 1.0f/r->cc->window;
 				if(r->accumulator >= 1){
 					r->accumulator = 0;
 					r->cc->window++;
 				}
 				r->timeout = false;
+			} else {
+				//delay_cc decides, once the RTT is known
+				r->timeout = false;
 			}
 		}
 		current = r->sending_window;
 	}
+	if(r->ts_ecr){
+		//the echo tells which transmission got through, resent or not
+		uint64_t echoed = clock_now() - (uint64_t)(ts_now() - r->ts_ecr) * 1000;
+		if(echoed > r->rack_xmit)
+			r->rack_xmit = echoed;
+		if(acked){
+			have_sample = true;
+			sen = echoed;
+		}
+	} else if(pkt->len == ACK_HEADER_SIZE && ackno - 1 == r->lastSeqAcked
+			&& r->sending_window && r->sending_window->next){
+		//a duplicate: something sent after the first hole got through,
+		//at the earliest the packet that first followed it
+		if(r->sending_window->next->sen > r->rack_xmit)
+			r->rack_xmit = r->sending_window->next->sen;
+	}
+	if(acked)
+		r->tlp_out = false;
+	if(rebuilt){
+		r->stats.fec_repaired++;
+		if(!cut)
+			time_out(r);
+	}
+	if(have_sample){
+		long us = rtt_sample(r, sen);
+		if(r->cc->cc_algo != CC_AIMD)
+			delay_cc(r, ackno, acked, us);
+	}
+	if(acked)
+		rate_sample(r);
+	if(r->eifel_seq && ackno > r->eifel_seq){
+		if(r->ts_ecr && (int32_t)(r->ts_ecr - r->eifel_ts) < 0){
+			//acked by the first transmission, nothing was lost
+			if(r->eifel_window > r->cc->window)
+				r->cc->window = r->eifel_window;
+			if(r->fec_holes + r->stats.fec_repaired > r->fec_epoch_lost)
+				r->fec_holes--;
+			r->stats.spurious_rtos++;
+		}
+		r->eifel_seq = 0;
+	}
+	ecn_ack(r, ackno, acked, (ntohl(pkt->rwnd) & PKT_ECE) != 0);
+	stats_hist_add(r->stats.cwnd_hist, r->cc->window);
+	stats_hist_add(r->stats.ssthresh_hist, r->sthresh > 0 ? r->sthresh : 0);
 
-	if(r->sent_EOF){
-		fprintf(stderr, "RECEIVED ACK FOR EOF!\n");
+	if(r->sending_window == NULL){
+		//nothing left to time out
+		r->rto_deadline = 0;
+	}
+	rack_detect(r);
+	tlp_arm(r);
+
+	if(r->sent_EOF && r->sending_window == NULL){
+		log_info("RECEIVED ACK FOR EOF!\n");
 		//sent an EOF packet and everything has been ACKed.
 		r->sender_finished = true;
-		if(r->receiver_finished) rel_destroy(r);
-		return;
+		if(r->receiver_finished){
+			rel_finish(r);
+			return true;
+		}
+		return false;
 	}
 
-	r->lastSeqAcked = ackno-1;
-
-	//call rel_read
-	rel_read(r);
+	//a piggybacked ack may come late, behind a newer one, and one for
+	//more than was sent is left over from an earlier connection
+	if(ackno > r->lastSeqAcked + 1 && ackno <= r->lastSeqSent + 1)
+		r->lastSeqAcked = ackno-1;
+	return false;
 }
 
 void send_ack(rel_t *r){
 	//make the ack
 	packet_t ackPkt;
-	ackPkt.len = htons(ACK_HEADER_SIZE);
-	ackPkt.ackno = htonl(r->nextSeqExpected);
+	stamp_ack(r, &ackPkt, r->fec_ack ? PKT_FEC : 0);
+	r->fec_ack = false;
+	int len = ts_stamp(r, &ackPkt, ACK_HEADER_SIZE);
+	ackPkt.len = htons(len);
 	memset(&(ackPkt.cksum),0,sizeof(uint16_t));
-	ackPkt.cksum = cksum((void*)(&ackPkt),ACK_HEADER_SIZE);
+	ackPkt.cksum = cksum((void*)(&ackPkt),len);
 
 	//send the ack
-	conn_sendpkt(r->c, &ackPkt, ACK_HEADER_SIZE);
+	conn_sendpkt(r->c, &ackPkt, len);
+	r->stats.acks_sent++;
+}
+
+/*
+ * Sends the packet of w, kept in host byte order in the window, with the
+ * current ack piggybacked.
+ */
+void send_data(rel_t *r, window_entry *w){
+	packet_t packet;
+	memcpy(&packet, &w->pkt, w->pkt.len);
+	packet.seqno = htonl(w->pkt.seqno);
+	stamp_ack(r, &packet, (r->cc->ecn && (r->features & HELLO_ECN) ? PKT_ECT : 0) | w->flags);
+	int len = ts_stamp(r, &packet, w->pkt.len);
+	packet.len = htons(len);
+	memset(&(packet.cksum),0,sizeof(uint16_t));
+	packet.cksum = cksum((void*)&packet, len);
+
+	conn_sendpkt(r->c, &packet, len);
+	w->xmit = clock_now();
+	r->stats.pkts_sent++;
+	r->stats.bytes_sent += w->pkt.len - PKT_HEADER_SIZE;
 }
 
+/*
+ * Returns a window entry with room for a packet of `payload` bytes.
+ */
+window_entry *new_entry(int payload){
+	return xmalloc(offsetof(window_entry, pkt.data) + payload);
+}
+
+/*
+ * The largest payload r sends, -m or else PKT_DATA_BASE.
+ */
+int send_max(rel_t *r){
+	return r->cc->mss ? r->cc->mss : PKT_DATA_BASE;
+}
+
+/*
+ * The largest payload r accepts, -m or else PKT_DATA_MAX.
+ */
+int recv_max(rel_t *r){
+	return r->cc->mss ? r->cc->mss : PKT_DATA_MAX;
+}
+
+/*
+ * Sends a round of connection setup: the HELLO, if it is still
+ * unanswered, and the payload size probes, if they are still going.
+ * The round is sent again if nothing settles it in time.
+ */
+void setup_send(rel_t *r){
+	if(r->hello_wait)
+		hello_send(r, hello_features(r), r->cc->init_window);
+	if(r->probing)
+		probe_send(r);
+	r->setup_sent = clock_now();
+	//until the first answer, back off as for retransmissions
+	if(r->srtt_us)
+		r->setup_deadline = r->setup_sent + 2 * r->srtt_us * 1000;
+	else
+		r->setup_deadline = r->setup_sent + (RTO_TICKS * r->cc->timer * NSEC_PER_MSEC << r->setup_round);
+}
 
+/*
+ * Lets the data go once the handshake and the probes are both over.
+ */
+void setup_done(rel_t *r){
+	if(r->hello_wait || r->probing)
+		return;
+	r->setup_deadline = 0;
+	if(r->features & HELLO_TS){
+		//room for the trailer in packets of the size that got through
+		r->seg -= PKT_TS_SIZE;
+	}else if(r->seg > PKT_DATA_BASE){
+		//the fixed RTO is sized for base payloads, and a window of
+		//larger ones takes longer to drain than that, so every burst
+		//would time out; only timestamps let the RTO follow
+		r->seg = PKT_DATA_BASE;
+		log_info("Payload %d bytes, the receiver does not take timestamps\n", r->seg);
+	}
+	if(r->features & HELLO_FEC){
+		//and for the parity header
+		r->seg -= PKT_FEC_SIZE;
+		r->fec_tx = xmalloc(sizeof(*r->fec_tx));
+		r->fec_tx->count = 0;
+		r->fec_size = r->cc->fec > 0 ? r->cc->fec : 0;
+	}
+	if(r->features & HELLO_FULL)
+		r->raw_hold = xmalloc(r->seg);
+	if(r->features & HELLO_ZIP){
+		//without a stream the payloads just go out as they are
+		r->zip_tx = zip_new(r->cc->zip, r->cc->zip_level, true);
+		if(r->zip_tx){
+			r->zip_raw = xmalloc(ZIP_CHUNK);
+			r->zip_stage = xmalloc(zip_bound(r->zip_tx, ZIP_CHUNK));
+		}
+	}
+	rel_read(r);
+}
+
+/*
+ * The HELLO_* features r offers: a sender those its options turn on,
+ * and HELLO_FULL unless it reads a terminal, a receiver all it
+ * supports.
+ */
+uint32_t hello_features(rel_t *r){
+	if(r->c->sender_receiver == RECEIVER)
+		return HELLO_ECN | HELLO_TS | HELLO_FEC | zip_hello(ZIP_ZLIB)
+			| (r->direct_write ? HELLO_FULL : 0);
+	return (r->cc->ecn ? HELLO_ECN : 0) | (r->cc->timestamps ? HELLO_TS : 0)
+		| (r->cc->fec ? HELLO_FEC : 0) | zip_hello(r->cc->zip)
+		| (conn_input_interactive(r->c) ? 0 : HELLO_FULL);
+}
+
+/*
+ * The HELLO_* bit of a ZIP_* codec, 0 for ZIP_OFF.
+ */
+uint32_t zip_hello(int codec){
+	switch(codec){
+	case ZIP_ZLIB:
+		return HELLO_ZLIB;
+	}
+	return 0;
+}
+
+/*
+ * The ZIP_* codec agreed in features, which has at most one of them.
+ */
+int zip_codec(uint32_t features){
+	if(features & HELLO_ZLIB)
+		return ZIP_ZLIB;
+	return ZIP_OFF;
+}
+
+/*
+ * Sends a HELLO, see struct hello: an offer from the sender, an answer
+ * from the receiver.
+ */
+void hello_send(rel_t *r, uint32_t features, int init_window){
+	packet_t hello;
+	struct hello h;
+	int len = PKT_HEADER_SIZE + sizeof(h);
+
+	h.features = htonl(features);
+	h.mss = htonl(r->c->sender_receiver == SENDER ? send_max(r) : recv_max(r));
+	h.window = htonl(r->rcv_window);
+	h.init_window = htonl(init_window);
+	h.conn_id = htonl(r->c->sender_receiver == SENDER ? r->conn_id : 0);
+	memset(&hello, 0, PKT_HEADER_SIZE);
+	memcpy(hello.data, &h, sizeof(h));
+	hello.len = htons(len);
+	hello.rwnd = htonl(PKT_HELLO | r->rcv_window);
+	hello.cksum = cksum((void*)&hello, len);
+	conn_sendpkt(r->c, &hello, len);
+}
+
+/*
+ * Answers a HELLO, or takes in the answer to ours.  The receiver answers
+ * every copy, since the sender repeats its offer until one gets back.
+ */
+void hello_recv(rel_t *r, packet_t *pkt){
+	struct hello h;
+	int init;
+
+	if(pkt->len < PKT_HEADER_SIZE + HELLO_MIN_SIZE)
+		return;
+	//an offer from a sender that predates conn_id ends before it
+	memset(&h, 0, sizeof(h));
+	memcpy(&h, pkt->data, pkt->len - PKT_HEADER_SIZE < sizeof(h) ? pkt->len - PKT_HEADER_SIZE : sizeof(h));
+	init = ntohl(h.init_window);
+	if(r->c->sender_receiver == RECEIVER){
+		r->conn_id = ntohl(h.conn_id);
+		if(r->rcv.base == 1 && !recvwin_has(&r->rcv, 1)){
+			//data has not started, and its payload size may change
+			r->seg = 0;
+		}
+		r->features = ntohl(h.features) & hello_features(r);
+		r->peer_window = ntohl(h.window);
+		if(r->features & HELLO_FEC){
+			//the packets a parity covers stay at hand after delivery
+			recvwin_keep(&r->rcv);
+		}
+		if((r->features & HELLO_ZIP) && !r->zip_rx
+				&& !(r->zip_rx = zip_new(zip_codec(r->features), 0, false)))
+			r->features &= ~HELLO_ZIP;
+		if(r->zip_rx && r->direct_write){
+			//seqnos no longer say where a payload goes in the output
+			r->direct_write = false;
+			recvwin_slots(&r->rcv);
+		}
+		if(!r->direct_write){
+			//full packets are of no use to a stream
+			r->features &= ~HELLO_FULL;
+		}
+		//no more in flight than the receiving window holds
+		hello_send(r, r->features, init < r->rcv_window ? init : r->rcv_window);
+		return;
+	}
+
+	if(!r->hello_wait)
+		return;
+	r->hello_wait = false;
+	if(!r->srtt_us){
+		//the setup round goes out together, so this is about an RTT
+		rtt_sample(r, r->setup_sent);
+	}
+	r->features = ntohl(h.features) & hello_features(r);
+	r->peer_window = ntohl(h.window);
+	if(!r->peer_max)
+		r->peer_max = ntohl(h.mss);
+	if(init > r->cc->window)
+		r->cc->window = init;
+	log_info("Handshake: features %#x, window %d, initial window %d\n",
+		r->features, r->peer_window, r->cc->window);
+	if(r->probing && r->seg >= r->peer_max)
+		probe_done(r);
+	else
+		setup_done(r);
+}
+
+/*
+ * Sends a round of payload size probes, DPLPMTUD style (RFC 8899) but
+ * all at once, so the search takes a round trip rather than one per
+ * size: one probe per size that would fill a 1500 or 9000 byte MTU, and
+ * one of the largest we may send, leaving out sizes already known to
+ * get through or that the peer does not accept.  Data waits until the
+ * largest comes back or SETUP_TRIES rounds have timed out.  The payload
+ * size cannot change later, since a direct write receiver places
+ * payloads by seqno.
+ */
+void probe_send(rel_t *r){
+	int max = send_max(r);
+	int sizes[] = { 1500 - IP_UDP_HEADER_SIZE - PKT_HEADER_SIZE,
+		9000 - IP_UDP_HEADER_SIZE - PKT_HEADER_SIZE, 0 };
+	int n = sizeof(sizes) / sizeof(sizes[0]);
+	int i, size;
+	packet_t probe;
+
+	if(r->peer_max && r->peer_max < max)
+		max = r->peer_max;
+	sizes[n - 1] = max;
+	memset(&probe, 0, sizeof(probe));
+	for(i = 0; i < n; i++){
+		size = sizes[i];
+		if(size <= r->seg || size > max || (i < n - 1 && size == max))
+			continue;
+		probe.len = htons(PKT_HEADER_SIZE + size);
+		probe.rwnd = htonl(PKT_PROBE);
+		probe.cksum = 0;
+		probe.cksum = cksum((void*)&probe, PKT_HEADER_SIZE + size);
+		conn_sendpkt(r->c, &probe, PKT_HEADER_SIZE + size);
+		r->stats.probes_sent++;
+	}
+}
+
+/*
+ * Answers a probe, or takes in the answer to one of ours.
+ */
+void probe_recv(rel_t *r, packet_t *pkt){
+	if(pkt->len > ACK_HEADER_SIZE){
+		packet_t ans;
+		if(r->rcv.base == 1 && !recvwin_has(&r->rcv, 1)){
+			//data has not started, and may come in the size probed
+			r->seg = 0;
+		}
+		ans.len = htons(ACK_HEADER_SIZE);
+		ans.ackno = htonl(recv_max(r));
+		ans.rwnd = htonl(PKT_PROBE | (pkt->len - PKT_HEADER_SIZE));
+		ans.cksum = 0;
+		ans.cksum = cksum((void*)&ans, ACK_HEADER_SIZE);
+		conn_sendpkt(r->c, &ans, ACK_HEADER_SIZE);
+		return;
+	}
+
+	int size = ntohl(pkt->rwnd) & RWND_MASK;
+	if(!r->probing)
+		return;
+	if(!r->srtt_us){
+		//the probes of a round go out together, so this is about an RTT
+		rtt_sample(r, r->setup_sent);
+	}
+	r->peer_max = pkt->ackno;
+	if(size <= r->peer_max && size > r->seg)
+		r->seg = size;
+	if(r->seg >= send_max(r) || r->seg >= r->peer_max)
+		probe_done(r);
+}
+
+/*
+ * Ends probing with the largest payload that got through.
+ */
+void probe_done(rel_t *r){
+	r->probing = false;
+	log_info("Payload %d bytes\n", r->seg);
+	setup_done(r);
+}
+
+/*
+ * Fills in the ack of an outgoing packet: the next seqno expected, our
+ * receiving window with flags, and the echo of a congestion mark due.
+ */
+void stamp_ack(rel_t *r, packet_t *pkt, uint32_t flags){
+	pkt->ackno = htonl(r->nextSeqExpected);
+	pkt->rwnd = htonl(r->rcv_window | flags | (r->ce_pending ? PKT_ECE : 0));
+	r->ce_pending = false;
+}
+
+/*
+ * Our clock for timestamps, microseconds modulo 2^32 but never 0.
+ */
+uint32_t ts_now(void){
+	uint32_t t = clock_now() / 1000;
+	return t ? t : 1;
+}
+
+/*
+ * Appends the timestamp trailer to the first len bytes of pkt if
+ * HELLO_TS is agreed, and returns the length to send.  pkt->rwnd must be
+ * stamped already.
+ */
+int ts_stamp(rel_t *r, packet_t *pkt, int len){
+	struct timestamp ts;
+	if(!(r->features & HELLO_TS))
+		return len;
+	ts.tsval = htonl(ts_now());
+	ts.tsecr = htonl(r->ts_recent);
+	memcpy((char*)pkt + len, &ts, PKT_TS_SIZE);
+	pkt->rwnd |= htonl(PKT_TS);
+	return len + PKT_TS_SIZE;
+}
+
+/*
+ * Takes the timestamp trailer off pkt, whose len is in host byte order.
+ * Its tsval is echoed by whatever we send next, which for an ack-every-
+ * packet receiver is the ack of pkt itself; its tsecr is left in
+ * r->ts_ecr for process_ack.
+ */
+void ts_recv(rel_t *r, packet_t *pkt){
+	struct timestamp ts;
+	pkt->len -= PKT_TS_SIZE;
+	memcpy(&ts, (char*)pkt + pkt->len, PKT_TS_SIZE);
+	r->ts_recent = ntohl(ts.tsval);
+	r->ts_ecr = ntohl(ts.tsecr);
+}
+
+
+
+/*
+ * Adds w, just sent for the first time, to the parity group, and sends
+ * the parity once the group is full or the data is over.  With
+ * FEC_AUTO the group size follows the loss rate p, taken every
+ * FEC_EPOCH packets from the holes resent and the rebuilds since, as a
+ * parity per 1/(4p) packets: one loss per group is all XOR can rebuild,
+ * and at a quarter of a loss per group two stay rare even while p runs
+ * behind the link.  Below FEC_LOSS_MIN, and until a loss is seen, no
+ * parity is sent at all; timeouts that Eifel finds spurious (see
+ * process_ack) are not losses.  Only the first unacked packet counts,
+ * since with cumulative acks everything behind a loss times out as well.
+ */
+void fec_next(rel_t *r, window_entry *w){
+	uint64_t sent = r->lastSeqSent - r->fec_epoch_seq;
+	uint64_t lost = r->fec_holes + r->stats.fec_repaired;
+
+	if(r->fec_size){
+		fec_add(r->fec_tx, w->seq, w->pkt.data, w->pkt.len - PKT_HEADER_SIZE, w->flags);
+		if(r->fec_tx->count >= r->fec_size || r->sent_EOF)
+			fec_send(r);
+	}
+	if(r->cc->fec != FEC_AUTO || sent < FEC_EPOCH || r->fec_tx->count)
+		return;
+	r->fec_loss += ((float)(lost - r->fec_epoch_lost) / sent - r->fec_loss) / 4;
+	r->fec_epoch_seq = r->lastSeqSent;
+	r->fec_epoch_lost = lost;
+	if(r->fec_loss < FEC_LOSS_MIN)
+		r->fec_size = 0;
+	else if(r->fec_loss * 4 * FEC_GROUP_MAX <= 1)
+		r->fec_size = FEC_GROUP_MAX;
+	else if(r->fec_loss * 4 * FEC_GROUP_MIN >= 1)
+		r->fec_size = FEC_GROUP_MIN;
+	else
+		r->fec_size = 1 / (4 * r->fec_loss);
+}
+
+/*
+ * Sends the parity of the group so far and starts the next one.
+ */
+void fec_send(rel_t *r){
+	packet_t parity;
+	int len;
+
+	memset(&parity, 0, PKT_HEADER_SIZE);
+	parity.seqno = htonl(r->fec_tx->first);
+	len = PKT_HEADER_SIZE + fec_parity(r->fec_tx, &parity);
+	stamp_ack(r, &parity, PKT_FEC);
+	len = ts_stamp(r, &parity, len);
+	parity.len = htons(len);
+	parity.cksum = cksum((void*)&parity, len);
+	conn_sendpkt(r->c, &parity, len);
+	r->stats.fec_sent++;
+}
+
+/*
+ * Takes in a parity packet, replacing the oldest one held if need be.
+ * Returns true if it rebuilt a packet into out, to go on as if that
+ * had arrived; a parity that rebuilds nothing is not acked.
+ */
+bool fec_recv(rel_t *r, packet_t *pkt, packet_t *out){
+	fec_group *g;
+
+	if(!(r->features & HELLO_FEC) || r->c->sender_receiver != RECEIVER)
+		return false;
+	r->stats.fec_rcvd++;
+	if(!r->fec_rx[r->fec_rx_next])
+		r->fec_rx[r->fec_rx_next] = xmalloc(sizeof(fec_group));
+	g = r->fec_rx[r->fec_rx_next];
+	r->fec_rx_next = (r->fec_rx_next + 1) % FEC_KEEP;
+	if(fec_parse(g, seq_extend(r->nextSeqExpected, pkt->seqno), pkt->data,
+			pkt->len - PKT_HEADER_SIZE) < 0)
+		return false;
+	return fec_repair(r, out) != 0;
+}
+
+/*
+ * Rebuilds into out a packet that one of the parity packets held has
+ * become enough for, and returns its seqno, or 0 if there is none.
+ * Parity of no further use is let go.
+ */
+uint64_t fec_repair(rel_t *r, packet_t *out){
+	int64_t seq;
+	int i;
+
+	for(i = 0; i < FEC_KEEP; i++){
+		if(!r->fec_rx[i] || !r->fec_rx[i]->count)
+			continue;
+		seq = fec_rebuild(r->fec_rx[i], &r->rcv, out);
+		if(seq == 0)
+			continue;
+		r->fec_rx[i]->count = 0;
+		if(seq > 0){
+			log_debug("FEC: rebuilt %" PRId64 "\n", seq);
+			r->stats.fec_rebuilt++;
+			r->fec_ack = true;
+			return seq;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Reads the payload of the next data packet into buf and returns its
+ * length, 0 if there is nothing to read or -1 at EOF like conn_input,
+ * setting *flags to PKT_ZIP if it is compressed.
+ */
+int read_payload(rel_t *r, char *buf, uint32_t *flags){
+	int n;
+	*flags = 0;
+	if(!r->zip_tx && r->zip_off < r->zip_len){
+		//input of the chunk that failed to compress, see zip_input
+		n = r->zip_len - r->zip_off;
+		if(n > r->seg)
+			n = r->seg;
+		memcpy(buf, r->zip_stage + r->zip_off, n);
+		r->zip_off += n;
+		r->stats.zip_bypassed += n;
+		return n;
+	}
+	if(!r->zip_tx)
+		return read_raw(r, buf);
+	if(r->zip_off == r->zip_len && r->zip_bypass > 0){
+		//the last chunk did not compress, so the input may not either
+		n = read_raw(r, buf);
+		if(n > 0){
+			r->zip_bypass -= n;
+			r->stats.zip_bypassed += n;
+		}
+		return n;
+	}
+	n = zip_input(r, buf);
+	if(n == 0 && !r->zip_tx){
+		//compression failed before anything went into buf
+		return read_payload(r, buf, flags);
+	}
+	if(n > 0)
+		*flags = PKT_ZIP;
+	return n;
+}
+
+/*
+ * Reads up to r->seg bytes of input into buf, returning like conn_input.
+ * A short read is topped up from what else the input has.  With
+ * HELLO_FULL agreed, what is still short is held back in r->raw_hold
+ * and 0 returned, until the rest arrives or the input ends.
+ */
+int read_raw(rel_t *r, char *buf){
+	int n;
+	if(r->raw_hold){
+		while(r->raw_held < r->seg){
+			n = conn_input(r->c, r->raw_hold + r->raw_held, r->seg - r->raw_held);
+			if(n == 0)
+				return 0;
+			if(n < 0){
+				if(!r->raw_held)
+					return -1;
+				break;
+			}
+			r->raw_held += n;
+		}
+		n = r->raw_held;
+		memcpy(buf, r->raw_hold, n);
+		r->raw_held = 0;
+		return n;
+	}
+	n = conn_input(r->c, buf, r->seg);
+	while(n > 0 && n < r->seg){
+		int more = conn_input(r->c, buf + n, r->seg - n);
+		if(more <= 0)
+			break;
+		n += more;
+	}
+	return n;
+}
+
+/*
+ * Fills buf with up to r->seg bytes of the compressed stream, returning
+ * like conn_input.  Input is compressed ZIP_CHUNK bytes at a time and
+ * flushed, so the receiver can decompress every packet as it is
+ * delivered.  A chunk that does not shrink to ZIP_WORTH percent of its
+ * size still goes out, but the next ZIP_BYPASS bytes of input are sent
+ * as they are (see read_payload) before compression is tried again.  A
+ * packet carries pieces of at most ZIP_PACKET_CHUNKS chunks, which bounds
+ * what it decompresses to (see zip_output).
+ */
+int zip_input(rel_t *r, char *buf){
+	int n = 0, got = 0, k;
+	int chunks = r->zip_off < r->zip_len;
+	while(n < r->seg){
+		if(r->zip_off == r->zip_len){
+			if(r->zip_bypass > 0 || chunks == ZIP_PACKET_CHUNKS)
+				break;
+			got = conn_input(r->c, r->zip_raw, ZIP_CHUNK);
+			if(got <= 0)
+				break;
+			k = zip_compress(r->zip_tx, r->zip_raw, got, r->zip_stage);
+			if(k < 0){
+				//the stream cannot go on, so this chunk and the rest
+				//of the input go out as they are (see read_payload)
+				log_warn("Compression failed, sending uncompressed\n");
+				zip_free(r->zip_tx);
+				r->zip_tx = NULL;
+				memcpy(r->zip_stage, r->zip_raw, got);
+				r->zip_len = got;
+				r->zip_off = 0;
+				return n;
+			}
+			r->stats.zip_bytes_in += got;
+			r->stats.zip_bytes_out += k;
+			if((long)k * 100 > (long)got * ZIP_WORTH)
+				r->zip_bypass = ZIP_BYPASS;
+			r->zip_len = k;
+			r->zip_off = 0;
+			chunks++;
+			continue;
+		}
+		k = r->zip_len - r->zip_off;
+		if(k > r->seg - n)
+			k = r->seg - n;
+		memcpy(buf + n, r->zip_stage + r->zip_off, k);
+		r->zip_off += k;
+		n += k;
+	}
+	return n ? n : got;
+}
+
+/*
+ * Decompresses the payload of a PKT_ZIP packet, the next piece of the
+ * stream, into r->zip_out for zip_drain to write.  Returns false if it
+ * does not decompress, or to more than the ZIP_PACKET_CHUNKS chunks a
+ * packet can carry pieces of.
+ */
+bool zip_output(rel_t *r, const char *data, int n){
+	int len = -1;
+	r->zip_out_len = 0;
+	r->zip_out_off = 0;
+	if(r->zip_rx)
+		len = zip_decompress(r->zip_rx, data, n, &r->zip_out, &r->zip_cap,
+			(size_t)ZIP_PACKET_CHUNKS * ZIP_CHUNK);
+	if(len < 0){
+		log_error("Corrupt compressed payload, connection dropped\n");
+		return false;
+	}
+	r->zip_out_len = len;
+	return true;
+}
+
+/*
+ * Writes as much of r->zip_out as the output has room for, since one
+ * packet can decompress to many times what conn_bufspace was checked
+ * against.  Returns true once all of it is written.
+ */
+bool zip_drain(rel_t *r){
+	size_t space;
+	while(r->zip_out_off < r->zip_out_len && (space = conn_bufspace(r->c)) > 0){
+		int k = r->zip_out_len - r->zip_out_off;
+		if((size_t)k > space)
+			k = space;
+		if(conn_output(r->c, r->zip_out + r->zip_out_off, k) < 0)
+			break;
+		r->zip_out_off += k;
+		r->stats.bytes_delivered += k;
+	}
+	if(r->zip_out_off < r->zip_out_len)
+		return false;
+	r->zip_out_len = 0;
+	r->zip_out_off = 0;
+	return true;
+}
+
+/*
+ * Reacts to congestion marks echoed in an ack that newly acked `acked`
+ * packets.  The window is cut at most once per window of data: to half
+ * with -E on, and by alpha/2 with -E dctcp, alpha being a moving average
+ * (gain 1/16) of the fraction of packets marked per window.
+ */
+void ecn_ack(rel_t *r, uint64_t ackno, int acked, bool ece){
+	if(ece)
+		r->stats.ece_rcvd++;
+	if(r->cc->ecn == ECN_DCTCP){
+		r->dctcp_acked += acked;
+		if(ece)
+			r->dctcp_marked += acked;
+		if(ackno > r->dctcp_end && r->dctcp_acked){
+			float f = (float)r->dctcp_marked / r->dctcp_acked;
+			r->dctcp_alpha += (f - r->dctcp_alpha) / 16;
+			r->dctcp_acked = r->dctcp_marked = 0;
+			r->dctcp_end = r->lastSeqSent;
+		}
+	}
+	if(!ece || r->cc->ecn == ECN_OFF || ackno <= r->ecn_recover){
+		return;
+	}
+
+	if(r->cc->ecn == ECN_DCTCP)
+		r->cc->window -= r->cc->window * r->dctcp_alpha / 2;
+	else
+		r->cc->window /= 2;
+	if(r->cc->window < 1)
+		r->cc->window = 1;
+	//carry on in congestion avoidance from the reduced window
+	r->sthresh = r->cc->window;
+	r->accumulator = 0;
+	r->ecn_recover = r->lastSeqSent;
+	r->stats.ecn_cuts++;
+}
+
+/*
+ * Delay-based window update for an ack that newly acked `acked` packets
+ * and gave an RTT sample of `us`.  Queueing delay is the RTT above the
+ * base RTT, the least seen over the last BASE_HISTORY minutes, so a
+ * route change is forgotten eventually.  Both leave slow start as soon
+ * as a queue builds instead of when it overflows.
+ *
+ * Vegas, once per round trip: from the least RTT of the round, the
+ * packets the window keeps queued are window * (rtt - base) / rtt;
+ * the window grows by one below VEGAS_ALPHA and shrinks by one above
+ * VEGAS_BETA.  Slow start ends on the first ack whose RTT shows more
+ * than VEGAS_GAMMA queued.
+ *
+ * LEDBAT (RFC 6817), on every ack: from the least of the last
+ * CUR_FILTER samples, the window moves by at most one packet per round
+ * trip in proportion to how far the queueing delay is off cc->target.
+ * It uses the RTT rather than one-way delay, so a queue on the ack path
+ * counts too.
+ *
+ * Loss and congestion marks still cut the window as for AIMD.
+ */
+void delay_cc(rel_t *r, uint64_t ackno, int acked, long us){
+	long base = base_rtt(r), cur, queued;
+	int i;
+
+	if(r->cc->cc_algo == CC_VEGAS){
+		if(r->sthresh > r->cc->window){
+			//the window doubles within a round, so this cannot wait for its end
+			if(r->cc->window * (us - base) / us > VEGAS_GAMMA){
+				//down to what fits the pipe, plus one
+				int fit = r->cc->window * base / us + 1;
+				if(fit < r->cc->window)
+					r->cc->window = fit;
+				r->sthresh = r->cc->window;
+				r->round_end = r->lastSeqSent;
+			}
+			return;
+		}
+		if(!r->round_min_us || us < r->round_min_us)
+			r->round_min_us = us;
+		if(ackno <= r->round_end)
+			return;
+		cur = r->round_min_us;
+		r->round_min_us = 0;
+		r->round_end = r->lastSeqSent;
+		queued = r->cc->window * (cur - base) / cur;
+		if(queued > VEGAS_BETA && r->cc->window > 2){
+			r->cc->window--;
+		} else if(queued < VEGAS_ALPHA){
+			r->cc->window++;
+		}
+		return;
+	}
+
+	//CC_LEDBAT
+	r->cur_rtt[r->cur_next] = us;
+	r->cur_next = (r->cur_next + 1) % CUR_FILTER;
+	cur = us;
+	for(i = 0; i < CUR_FILTER; i++){
+		if(r->cur_rtt[i] && r->cur_rtt[i] < cur)
+			cur = r->cur_rtt[i];
+	}
+	queued = cur - base;
+	if(r->sthresh > r->cc->window){
+		if(queued * 2 > r->cc->target * 1000L)
+			r->sthresh = r->cc->window;
+		return;
+	}
+	r->accumulator += (float)(r->cc->target * 1000L - queued) / (r->cc->target * 1000L)
+		* acked / r->cc->window;
+	while(r->accumulator >= 1){
+		r->accumulator -= 1;
+		r->cc->window++;
+	}
+	while(r->accumulator <= -1){
+		r->accumulator += 1;
+		if(r->cc->window > 2)
+			r->cc->window--;
+	}
+}
+
+/*
+ * The least RTT of the last BASE_HISTORY minutes, 0 before any sample.
+ */
+long base_rtt(rel_t *r){
+	long base = 0;
+	int i;
+	for(i = 0; i < BASE_HISTORY; i++){
+		if(r->base_hist[i] && (!base || r->base_hist[i] < base))
+			base = r->base_hist[i];
+	}
+	return base;
+}
+
+/*
+ * Seqnos and acknos are 64-bit inside, 32-bit on the wire.  Returns the
+ * 64-bit seqno with the low 32 bits wire closest to ref, i.e. RFC 1982
+ * serial number arithmetic: wire is taken to be ahead of ref if it is
+ * less than 2^31 ahead, and behind it otherwise.  ref is what the peer
+ * is expected to send next; windows are far smaller than 2^31, so every
+ * seqno or ackno still in play is recovered exactly.  Returns 0, which
+ * is no seqno, for one from before the first.
+ */
+uint64_t seq_extend(uint64_t ref, uint32_t wire){
+	int32_t d = (int32_t)(wire - (uint32_t)ref);
+	if(d < 0 && (uint64_t)-(int64_t)d > ref)
+		return 0;
+	return ref + d;
+}
+
+/*
+ * RACK loss detection.  The first unacked packet is lost if a packet
+ * sent after it has been delivered and it is more than an RTT plus a
+ * reordering window old, which takes one duplicate ack instead of three
+ * and also finds lost retransmissions.  With cumulative acks only that
+ * first hole can be known; a duplicate ack tells that something after
+ * it was delivered but not what, so without timestamps a resent hole is
+ * left to the timeout.  The reordering window is a quarter of the least
+ * RTT.
+ */
+void rack_detect(rel_t *r){
+	window_entry *w = r->sending_window;
+	uint64_t now = clock_now(), lost_at;
+	long reo;
+
+	r->rack_deadline = 0;
+	if(!w || !w->valid || !r->srtt_us || w->xmit >= r->rack_xmit)
+		return;
+	reo = (base_rtt(r) ? base_rtt(r) : r->srtt_us) / 4 * r->reo_mult;
+	if(reo > r->srtt_us)
+		reo = r->srtt_us;
+	lost_at = w->xmit + (uint64_t)(r->srtt_us + reo) * 1000;
+	if(now < lost_at){
+		r->rack_deadline = lost_at;
+		return;
+	}
+	log_debug("RACK: %" PRIu64 " lost\n", w->seq);
+	loss_cut(r);
+	if(!w->retransmitted)
+		r->fec_holes++;
+	w->retransmitted = true;
+	w->rto_at = now + rto(r);
+	send_data(r, w);
+	r->stats.retransmits++;
+	r->stats.rack_losses++;
+}
+
+/*
+ * Cuts the window for a loss found by duplicate acks or RACK, and
+ * remembers enough to undo it if the first unacked packet turns out to
+ * have been only reordered, see reorder_check.
+ */
+void loss_cut(rel_t *r){
+	int before = r->cc->window;
+	time_out(r);
+	if(r->cc->window == before || !r->sending_window)
+		return;
+	r->reo_seq = r->sending_window->seq;
+	r->reo_ts = ts_now();
+	r->reo_window = before;
+	if(r->reo_persist && --r->reo_persist == 0)
+		r->reo_mult = 1;
+}
+
+/*
+ * Called when the ack of w, the hole of the latest loss cut, arrives
+ * with `dups` duplicate acks before it.  The packet was only reordered
+ * if it was never resent, or if timestamps show the ack is for the
+ * first transmission; the cut is then undone, and unless -R fixed it
+ * the duplicate ack threshold rises past the reordering seen and the
+ * RACK reordering window grows by a quarter of the least RTT (RFC 8985
+ * uses DSACKs for that, which cumulative acks lack), both to stop the
+ * same reordering from counting as loss again.
+ */
+void reorder_check(rel_t *r, window_entry *w, int dups){
+	r->reo_seq = 0;
+	if(w->retransmitted && !(r->ts_ecr && (int32_t)(r->ts_ecr - r->reo_ts) < 0))
+		return;
+	if(r->reo_window > r->cc->window)
+		r->cc->window = r->reo_window;
+	r->stats.reorder_undos++;
+	if(r->cc->dupthresh)
+		return;
+	if(dups + 1 > r->dupthresh)
+		r->dupthresh = dups + 1 < DUPTHRESH_MAX ? dups + 1 : DUPTHRESH_MAX;
+	if(r->reo_mult < REO_MULT_MAX)
+		r->reo_mult++;
+	r->reo_persist = REO_PERSIST;
+	log_debug("Reordering: dupthresh %d, reordering window x%d\n", r->dupthresh, r->reo_mult);
+}
+
+/*
+ * Arms the tail loss probe two RTTs (at least a timer period) after the
+ * latest send or ack, if that is ahead of the retransmission timeout,
+ * so a loss at the end of a flight, where no duplicate acks will come,
+ * is found in about an RTT.
+ */
+void tlp_arm(rel_t *r){
+	uint64_t pto = 2 * r->srtt_us * 1000;
+
+	r->tlp_deadline = 0;
+	if(!r->sending_window || !r->srtt_us || r->tlp_out)
+		return;
+	if(pto < r->cc->timer * NSEC_PER_MSEC)
+		pto = r->cc->timer * NSEC_PER_MSEC;
+	if(clock_now() + pto < r->rto_deadline)
+		r->tlp_deadline = clock_now() + pto;
+}
+
+/*
+ * Sends a tail loss probe: one new packet beyond the window if there is
+ * data for it, or else the last packet again.  Its ack either shows
+ * nothing was lost or, as a duplicate, lets rack_detect find the hole.
+ */
+void tlp_send(rel_t *r){
+	uint64_t sent = r->stats.pkts_sent;
+	window_entry *w;
+
+	r->tlp_deadline = 0;
+	r->tlp_out = true;
+	r->tlp_extra = 1;
+	rel_read(r);
+	r->tlp_extra = 0;
+	if(r->stats.pkts_sent == sent){
+		for(w = r->sending_window; w && w->next; w = w->next)
+			;
+		if(!w)
+			return;
+		w->retransmitted = true;
+		send_data(r, w);
+		r->stats.retransmits++;
+	}
+	r->stats.tlp_probes++;
+}
+
+/*
+ * How many packets rel_read may have in flight: the window, plus one
+ * for each duplicate ack short of dupthresh but no more than
+ * LIMITED_TRANSMIT (limited transmit, RFC 3042) so a small window still
+ * gets the acks that find a loss, plus a tail loss probe.  A threshold
+ * raised for reordering does not raise the limit, or the extra packets
+ * would overrun the receiving window.  Without timestamps the duplicates
+ * a spurious timeout's resends draw count too, so once slow start has
+ * filled a queue past the fixed timeout the extra packets keep it full;
+ * the ssthresh the receiver's EOF gives (see deliver) is what stops slow
+ * start short of that.
+ */
+int send_allowance(rel_t *r){
+	int dups = r->duplicate_ack_num - 1;
+	int limit = r->dupthresh - 1 < LIMITED_TRANSMIT ? r->dupthresh - 1 : LIMITED_TRANSMIT;
+	return r->cc->window + (dups < limit ? dups : limit) + r->tlp_extra;
+}
+
+/*
+ * The retransmission timeout in ns: RTO_TICKS timer periods, or with
+ * timestamps srtt + 4 * rttvar (RFC 6298) if that is longer.  Only
+ * timestamps give samples of resent packets too, and the Eifel response
+ * (RFC 4015) to a spurious timeout is to wait longer next time; without
+ * it an RTT grown past the fixed timeout by queueing keeps timing out.
+ */
+uint64_t rto(rel_t *r){
+	uint64_t ns = RTO_TICKS * r->cc->timer * NSEC_PER_MSEC;
+	uint64_t est = (uint64_t)(r->srtt_us + 4 * r->rttvar_us) * 1000;
+	if((r->features & HELLO_TS) && est > ns)
+		return est;
+	return ns;
+}
+
+/*
+ * Starts the retransmission timer of w, which is being sent now.
+ */
+void arm_timer(rel_t *r, window_entry *w){
+	w->rto_at = w->sen + rto(r);
+	if(!r->rto_deadline || w->rto_at < r->rto_deadline)
+		r->rto_deadline = w->rto_at;
+}
 
 void windowList_enqueue(rel_t *r, window_entry *w, window_entry **head){
 	window_entry *current;
@@ -526,75 +2049,82 @@ void windowList_enqueue(rel_t *r, window_entry *w, window_entry **head){
 }
 
 /*
- * Adds a packet to the receiving end window.
- * Fills in the blanks in the window.
- * returns -1 when the packet cannot be added
- *          0 when the packet is redundant
- *          1 in success
+ * Receives a data packet when the output is a regular file and
+ * HELLO_FULL is agreed.  The payload is written straight to its place
+ * in the file, seqno n going to offset (n-1)*r->seg, so out of order
+ * packets need no buffering: r->rcv only remembers which seqnos have
+ * been written.
  */
-int windowList_smartAdd(rel_t *r, packet_t *pkt){
-
-	uint32_t seqno = pkt->seqno;
-	struct window_entry *w = r->receiving_window;
+void direct_recv(rel_t *r, packet_t *pkt, uint64_t seqno){
+	packet_t rebuilt;
+	uint64_t seq;
+
+	r->stats.pkts_rcvd++;
+	if(r->got_EOF || seqno < r->nextSeqExpected){
+		//already written, the ack must have been lost
+		r->stats.dup_pkts++;
+		send_ack(r);
+		return;
+	} else if(seqno - r->rcv.base >= (uint64_t)r->rcv_window){
+		log_info("Package of seqno %" PRIu64 " was not added. Far ahead.\n", seqno);
+		return;
+	}
 
-	if(r->got_EOF){
-		return 0;
-	} else if(seqno<r->nextSeqExpected || seqno>r->nextSeqExpected+r->cc->window){
-		//ignore packet that has already been processed or that is too far ahead
-		fprintf(stderr,"INFO: Package of seqno %d was not added. Already processed or far ahead.\n", seqno);
-		return -1;
-	} else if(r->receiving_window == NULL){
-		w = (window_entry *)xmalloc(sizeof(window_entry));
-		memset(&w->pkt, 0, sizeof(packet_t));
-		w->pkt.seqno = r->nextSeqExpected;
-		w->valid = false;
-		r->receiving_window = w;
-		w->next = NULL;
-		w->prev = NULL;
+	if(!r->seg){
+		//no place for it before seqno 1 gives the payload size; not
+		//marked, so it gets another try
+		return;
 	}
 
-	int safetyvar_memleak = 0;
-	//Find and close gaps!
-	window_entry *current = r->receiving_window;
-	while(current->pkt.seqno <= seqno){
-		int current_seqno = current->pkt.seqno;
-		if(safetyvar_memleak>r->cc->window+10){
-			fprintf(stderr, "ERROR: MEMLEAK at SMARTADD!\n");
-		}
-		//make next if necessary
-		if(current->next == NULL || current->next->pkt.seqno != (current_seqno+1)){
-			//Next window does not exist. Create subsequent window and insert
-			window_entry *nw = (window_entry *)xmalloc(sizeof(window_entry));
-			memset(&nw->pkt.data, 0, sizeof(packet_t));
-			nw->pkt.seqno = current_seqno + 1;
-			nw->valid = false;
-			nw->next = current->next;
-			nw->prev = current;
-			current->next = nw;
-			continue;
-		}
-		if(current_seqno == seqno){
-			if(!current->valid){
-				//Next window exists, check if valid, update if necessary
-				memcpy(&current->pkt, pkt, sizeof(packet_t));
-				current->valid = true;
-				return 1;
-			} else{
-				if(memcmp(pkt, &current->pkt, pkt->len)==0){
-					return 0; //packet was already there!
-				}
-				else{
-					fprintf(stderr, "ERROR: SAME PACKET SEQNO, DIFFERENT DATA");
-					return -1;
-				}
-			}
-		}
+	if(!recvwin_has(&r->rcv, seqno)){
+		if(!direct_place(r, pkt, seqno))
+			return;
+	} else {
+		r->stats.dup_pkts++;
+	}
+	//parity that was waiting on this packet
+	while(!r->got_EOF && (seq = fec_repair(r, &rebuilt)))
+		direct_place(r, &rebuilt, seq);
+
+	//slide the window over everything that is now contiguous
+	uint64_t gap = recvwin_first_gap(&r->rcv);
+	while(r->rcv.base != gap && !r->got_EOF){
+		if(r->rcv.base == r->eof_seqno)
+			r->got_EOF = true;
+		recvwin_advance(&r->rcv);
+	}
+	r->nextSeqExpected = r->rcv.base;
+	send_ack(r);
+
+	if(r->got_EOF && !r->c->write_eof){
+		log_info("GOT EOF at direct_recv!\n");
+		conn_output_at(r->c, NULL, 0, r->rcv_end);
+		if(r->sender_finished)
+			rel_finish(r);
+	}
+}
 
-		current = current->next;
-		safetyvar_memleak++;
+/*
+ * Writes the payload of seqno, which has not been written yet, to its
+ * place in the file, and marks it written.  Returns false if the write
+ * failed, leaving it unmarked so that the retransmission gets another
+ * try.
+ */
+bool direct_place(rel_t *r, packet_t *pkt, uint64_t seqno){
+	int payload = pkt->len - PKT_HEADER_SIZE;
+	if(payload == 0){
+		r->eof_seqno = seqno;
+	} else {
+		off_t off = (off_t)(seqno - 1) * r->seg;
+		if(conn_output_at(r->c, pkt->data, payload, off) < 0)
+			return false;
+		if(off + payload > r->rcv_end)
+			r->rcv_end = off + payload;
+		r->stats.bytes_delivered += payload;
 	}
-	fprintf(stderr, "ERROR: Could not smart add. Not smart enough...\n");
-	return -1;
+	//kept whole only for rebuilding from parity
+	recvwin_insert(&r->rcv, seqno, pkt, r->rcv.keep ? pkt->len : 0);
+	return true;
 }
 
 window_entry* windowList_dequeue(rel_t *r, window_entry **head){
@@ -611,10 +2141,10 @@ window_entry* windowList_dequeue(rel_t *r, window_entry **head){
 
 void printPacket(packet_t *pkt, rel_t *r){
 	if(ntohs(pkt->len)==ACK_HEADER_SIZE){
-		fprintf(stderr, "Ack ackno=%d | pid=%d\n", ntohl(pkt->ackno), r->pid);
+		log_printf(LOG_DEBUG, "Ack ackno=%d | pid=%d\n", ntohl(pkt->ackno), r->pid);
 		return;
 	}
-	fprintf(stderr, "Packet #=%d | l=%d | pid=%d | need = %d \n",ntohl(pkt->seqno), ntohs(pkt->len), r->pid, r->nextSeqExpected);
+	log_printf(LOG_DEBUG, "Packet #=%d | l=%d | pid=%d | need = %" PRIu64 " \n",ntohl(pkt->seqno), ntohs(pkt->len), r->pid, r->nextSeqExpected);
 
 }
 
@@ -623,9 +2153,172 @@ void time_out(rel_t *r){
 	if(r->cc->window==1 || r->timeout){
 		return;
 	} else if(r->cc->window<1){
-		fprintf(stderr, "ERROR!!! BAD WINDOW\n");
+		log_error("BAD WINDOW\n");
 	}
-	fprintf(stderr,"window %d\n", r->cc->window);
+	log_debug("window %d\n", r->cc->window);
 	r->cc->window = r->cc->window / 2;
 	r->timeout = true;
 }
+
+/*
+ * Folds one RTT measurement into srtt/rttvar (RFC 6298 gains) and the
+ * base RTT history, and returns it.
+ */
+long rtt_sample(rel_t *r, uint64_t sen){
+	long us = (clock_now() - sen) / 1000;
+	uint64_t minute = clock_now() / (60 * NSEC_PER_SEC);
+	if(us <= 0){
+		us = 1;
+	}
+	if(r->base_hist[r->base_cur] == 0){
+		r->base_hist[r->base_cur] = us;
+		r->base_minute = minute;
+	} else if(minute != r->base_minute){
+		r->base_cur = (r->base_cur + 1) % BASE_HISTORY;
+		r->base_hist[r->base_cur] = us;
+		r->base_minute = minute;
+	} else if(us < r->base_hist[r->base_cur]){
+		r->base_hist[r->base_cur] = us;
+	}
+	if(r->srtt_us == 0){
+		r->srtt_us = us;
+		r->rttvar_us = us / 2;
+	} else {
+		long err = us - r->srtt_us;
+		r->rttvar_us += ((err < 0 ? -err : err) - r->rttvar_us) / 4;
+		r->srtt_us += err / 8;
+	}
+	stats_hist_add(r->stats.srtt_hist, r->srtt_us);
+	return us;
+}
+
+/*
+ * Measures the delivery rate over each RTT, for the peer cache: the
+ * payload acked since the sample began over the time it took, once an
+ * RTT has gone by.  The cache keeps the largest.
+ */
+void rate_sample(rel_t *r){
+	uint64_t now = clock_now();
+	uint64_t rate;
+	if(!r->rate_start){
+		r->rate_start = now;
+		r->rate_acked = r->stats.bytes_acked;
+		return;
+	}
+	if(!r->srtt_us || now - r->rate_start < (uint64_t)r->srtt_us * 1000)
+		return;
+	rate = (r->stats.bytes_acked - r->rate_acked) * NSEC_PER_SEC / (now - r->rate_start);
+	if(rate > r->max_rate)
+		r->max_rate = rate;
+	r->rate_start = now;
+	r->rate_acked = r->stats.bytes_acked;
+}
+
+/*
+ * Starts a new sender from what finished connections to the same peer
+ * left in the peer cache (dstcache.h): their RTT estimate, and the
+ * bandwidth-delay product they delivered as ssthresh, or their own
+ * ssthresh if lower, with half of it as the initial window.  There is
+ * no pacing, so the whole initial window goes out at once.  The product
+ * halves for each CACHE_HALF_LIFE_MS the entry has aged and stays
+ * within CACHE_WINDOW_MAX and the receiving window; an entry older than
+ * CACHE_TTL_MS is not used at all.
+ */
+void cache_seed(rel_t *r){
+	const dst_metrics *m = dstcache_get(&r->c->peer);
+	uint64_t age, bdp;
+	int halvings, ssthresh;
+
+	if(!m)
+		return;
+	age = clock_now() - m->stamp;
+	if(age > (uint64_t)CACHE_TTL_MS * NSEC_PER_MSEC)
+		return;
+	halvings = age / ((uint64_t)CACHE_HALF_LIFE_MS * NSEC_PER_MSEC);
+
+	r->srtt_us = m->srtt_us;
+	//no surer than after a first sample (RFC 6298), or the timeout
+	//starts out tighter than the queue the window may build
+	r->rttvar_us = m->rttvar_us > m->srtt_us / 2 ? m->rttvar_us : m->srtt_us / 2;
+	//in packets of the largest payload, so fewer if the payload is smaller
+	bdp = m->rate * m->srtt_us / 1000000 / send_max(r) >> halvings;
+	if(bdp > CACHE_WINDOW_MAX)
+		bdp = CACHE_WINDOW_MAX;
+	if(bdp > (uint64_t)r->rcv_window)
+		bdp = r->rcv_window;
+	//slow start from half of what the path took, up to all of it
+	ssthresh = m->ssthresh;
+	if(bdp && (!ssthresh || (uint64_t)ssthresh > bdp))
+		ssthresh = bdp;
+	if(ssthresh && ssthresh < r->sthresh){
+		r->sthresh = ssthresh > CACHE_SSTHRESH_MIN ? ssthresh : CACHE_SSTHRESH_MIN;
+		r->cached_ssthresh = true;
+	}
+	if((int)bdp / 2 > r->cc->window){
+		r->cc->window = bdp / 2;
+		r->cached_window = r->cc->window;
+	}
+	log_info("Peer cache: srtt %ld us, ssthresh %d, window %d, %d s old\n",
+		r->srtt_us, r->sthresh, r->cc->window, (int)(age / NSEC_PER_SEC));
+}
+
+/*
+ * Leaves what a sender that got everything through learned about the
+ * path in the peer cache.  An ssthresh at the receiving window or above
+ * is none at all.
+ */
+void cache_store(rel_t *r){
+	dst_metrics m;
+	if(r->c->sender_receiver != SENDER || !r->sender_finished || !r->srtt_us)
+		return;
+	m.srtt_us = r->srtt_us;
+	m.rttvar_us = r->rttvar_us;
+	m.ssthresh = r->sthresh < r->rcv_window ? r->sthresh : 0;
+	m.cwnd = r->cc->window;
+	m.rate = r->max_rate;
+	dstcache_put(&r->c->peer, &m);
+}
+
+/*
+ * Appends the statistics of r as one line of JSON to the -S file, or to
+ * stderr if none was given.
+ */
+void write_stats(rel_t *r){
+	FILE *f = stderr;
+	double ms;
+	uint64_t good, wakeups, idle;
+
+	if(r->cc && r->cc->stats_file && !(f = fopen(r->cc->stats_file, "a"))){
+		perror(r->cc->stats_file);
+		return;
+	}
+	if(f == stderr){
+		//keep it after anything still queued in the log
+		log_flush();
+	}
+	ms = (clock_now() - r->start_time) / 1e6;
+	good = r->c->sender_receiver == RECEIVER ? r->stats.bytes_delivered : r->stats.bytes_acked;
+
+	//clock_ms is comparable between processes on one machine
+	fprintf(f, "{\"pid\":%d,\"role\":\"%s\",\"clock_ms\":%.3f,\"elapsed_ms\":%.3f,", r->pid,
+		r->c->sender_receiver == RECEIVER ? "receiver" : "sender", clock_now() / 1e6, ms);
+	stats_write_counters(f, &r->stats);
+	conn_wakeups(&wakeups, &idle);
+	fprintf(f, ",\"cwnd\":%d,\"ssthresh\":%d,\"srtt_ms\":%.3f,\"rttvar_ms\":%.3f,\"goodput_kbps\":%.1f",
+		r->cc ? r->cc->window : 0, r->sthresh, r->srtt_us / 1000.0, r->rttvar_us / 1000.0,
+		ms > 0 ? good * 8 / ms : 0);
+	fprintf(f, ",\"mss\":%d,\"features\":%" PRIu32 ",\"dupthresh\":%d,\"fec_group\":%d,\"base_rtt_ms\":%.3f,\"dctcp_alpha\":%.4f,\"wakeups\":%" PRIu64 ",\"idle_wakeups\":%" PRIu64,
+		r->seg, r->features, r->dupthresh, r->fec_size, base_rtt(r) / 1000.0, r->dctcp_alpha, wakeups, idle);
+	fprintf(f, ",\"cached_window\":%d,\"max_rate_kbps\":%.1f}\n",
+		r->cached_window, r->max_rate * 8 / 1000.0);
+	if(f != stderr){
+		fclose(f);
+	}
+}
+
+void rel_stats(void){
+	rel_t *r;
+	for(r = rel_list; r; r = r->next){
+		write_stats(r);
+	}
+}
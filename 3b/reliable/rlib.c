@@ -11,6 +11,7 @@
 #include <getopt.h>
 #include <assert.h>
 #include <stddef.h>
+#include <limits.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <netinet/in.h>
@@ -19,6 +20,10 @@
 #include <sys/stat.h>
 
 #include "rlib.h"
+#include "log.h"
+#include "pcap.h"
+#include "clock.h"
+#include "zip.h"
 
 char *progname;
 int opt_debug;
@@ -39,9 +44,9 @@ struct config_client {
 struct config_server {
   struct config_common c;
   int udp_socket;		/* Receive all UDP over this socket */
-  struct sockaddr_storage dest;	/* Demultiplex traffic and relay it to
-				   individual TCP connections to this
-				   address */
+  const char *dir;		/* Demultiplex traffic and write each
+				   transfer to a new file in this
+				   directory */
 };
 
 static struct config_server *serverconf;
@@ -58,7 +63,10 @@ static conn_t **evwriters;
 
 
 static conn_t *conn_list;
-struct timespec last_timeout;
+static uint64_t wakeups;		/* poll returns, see conn_wakeups */
+static uint64_t idle_wakeups;
+static uint64_t pkts_out;
+static volatile sig_atomic_t stats_requested;
 
 #if !DMALLOC
 void *
@@ -104,18 +112,17 @@ print_pkt (const packet_t *buf, const char *op, int n)
     pid = getpid ();
   if (n < 0) {
     if (errno != EAGAIN)
-      fprintf (stderr, "%5d %s(%3d): %s\n", pid, op, n, strerror (errno));
+      log_info ("%5d %s(%3d): %s\n", pid, op, n, strerror (errno));
   }
   else if (n == 12)
-    fprintf (stderr, "%5d %s(%3d): cksum = %04x, len = %04x, ack = %08x, rwnd = %d\n",
-	     pid, op, n, buf->cksum, ntohs (buf->len), ntohl (buf->ackno), ntohl(buf->rwnd));
+    log_info ("%5d %s(%3d): cksum = %04x, len = %04x, ack = %08x, rwnd = %d\n",
+		pid, op, n, buf->cksum, ntohs (buf->len), ntohl (buf->ackno), ntohl(buf->rwnd));
   else if (n >= 16)
-    fprintf (stderr,
-	     "%5d %s(%3d): cksum = %04x, len = %04x, ack = %08x, seq = %08x, rwnd = %d\n",
-	     pid, op, n, buf->cksum, ntohs (buf->len), ntohl (buf->ackno),
-	     ntohl (buf->seqno), ntohl(buf->rwnd));
+    log_info ("%5d %s(%3d): cksum = %04x, len = %04x, ack = %08x, seq = %08x, rwnd = %d\n",
+		pid, op, n, buf->cksum, ntohs (buf->len), ntohl (buf->ackno),
+		ntohl (buf->seqno), ntohl(buf->rwnd));
   else
-    fprintf (stderr, "%5d %s(%3d):\n", pid, op, n);
+    log_info ("%5d %s(%3d):\n", pid, op, n);
   errno = saved_errno;
 }
 
@@ -129,8 +136,11 @@ conn_sendpkt (conn_t *c, const packet_t *pkt, size_t len)
 		(const struct sockaddr *) &c->peer, addrsize (&c->peer));
   else
     n = send (c->nfd, pkt, len, 0);
-  if (opt_debug)
+  if (LOG_ON (LOG_INFO))
     print_pkt (pkt, "send", n);
+  if (pcap_enabled && n >= 0)
+    pcap_packet (c->nfd, 1, c->server ? &c->peer : NULL, pkt, n);
+  pkts_out++;
   return n;
 }
 
@@ -139,7 +149,7 @@ conn_bufspace (conn_t *c)
 {
   chunk_t *ch;
   size_t used = 0;
-  const size_t bufsize = 8192;
+  const size_t bufsize = 2 * PKT_DATA_MAX; /* Room for the largest payload */
 
 
   for (ch = c->outq; ch; ch = ch->next)
@@ -158,10 +168,7 @@ conn_output (conn_t *c, const void *_buf, size_t _n)
   if (n == 0) {
     c->write_eof = 1;
     if (!c->outq)
-    {
-      close(outfile);
       shutdown (c->wfd, SHUT_WR);
-    }
     return 0;
   }
 
@@ -208,6 +215,59 @@ conn_output (conn_t *c, const void *_buf, size_t _n)
   return _n;
 }
 
+int
+conn_output_seekable (conn_t *c)
+{
+  struct stat sb;
+
+  if (log_out >= 0)
+    return 0;
+  if (fstat (c->wfd, &sb) < 0)
+    return 0;
+  return S_ISREG (sb.st_mode);
+}
+
+int
+conn_output_at (conn_t *c, const void *_buf, size_t _n, off_t off)
+{
+  const char *buf = _buf;
+  size_t n = _n;
+
+  assert (!c->delete_me && !c->write_eof);
+
+  if (n == 0) {
+    c->write_eof = 1;
+    if (ftruncate (c->wfd, off) < 0)
+      perror ("ftruncate");
+    shutdown (c->wfd, SHUT_WR);
+    return 0;
+  }
+
+  if (c->write_err)
+    return -1;
+
+  while (n > 0) {
+    ssize_t r = pwrite (c->wfd, buf, n, off);
+    if (r < 0) {
+      if (errno == EINTR)
+	continue;
+      perror ("pwrite");
+      c->write_err = 2;
+      return -1;
+    }
+    buf += r;
+    off += r;
+    n -= r;
+  }
+  return _n;
+}
+
+int
+conn_input_interactive (conn_t *c)
+{
+  return isatty (c->rfd);
+}
+
 int
 conn_input (conn_t *c, void *buf, size_t n)
 {
@@ -232,8 +292,6 @@ conn_input (conn_t *c, void *buf, size_t n)
 
   c->xoff = 0;
   cevents[c->rpoll].events |= POLLIN;
-  if(r < 0)
-    close(infile);
   return r;
 }
 
@@ -257,6 +315,10 @@ conn_alloc (void)
 conn_t *
 conn_create (rel_t *rel, const struct sockaddr_storage *ss)
 {
+  static unsigned long transfers;
+  char path[PATH_MAX];
+  char addr[NI_MAXHOST] = "unknown";
+  char port[NI_MAXSERV] = "unknown";
   int n;
   conn_t *c;
 
@@ -265,25 +327,27 @@ conn_create (rel_t *rel, const struct sockaddr_storage *ss)
    * in the client, you will see this assertion fail. */
   assert (serverconf);
 
-  if ((n = connect_to (0, &serverconf->dest)) < 0) {
-    char addr[NI_MAXHOST] = "unknown";
-    char port[NI_MAXSERV] = "unknown";
-    int saved_errno = errno;
-    getnameinfo ((const struct sockaddr *) &serverconf->dest,
-		 sizeof (serverconf->dest),
-		 addr, sizeof (addr), port, sizeof (port),
-		 NI_DGRAM | NI_NUMERICHOST | NI_NUMERICSERV);
-    fprintf (stderr, "%s:%s: connect: %s\n",
-	     addr, port, strerror (saved_errno));
+  snprintf (path, sizeof (path), "%s/%lu", serverconf->dir, ++transfers);
+  if ((n = open (path, O_RDWR|O_CREAT|O_TRUNC, S_IWRITE|S_IREAD)) < 0) {
+    perror (path);
     return NULL;
   }
+  make_async (n);
+  getnameinfo ((const struct sockaddr *) ss, addrsize (ss),
+	       addr, sizeof (addr), port, sizeof (port),
+	       NI_DGRAM | NI_NUMERICHOST | NI_NUMERICSERV);
+  log_info ("Transfer from %s:%s to %s\n", addr, port, path);
 
+  /* A receiver: its side of the transfer is only an EOF */
   c = conn_alloc ();
   c->peer = *ss;
   c->rel = rel;
   c->nfd = serverconf->udp_socket;
-  c->rfd = c->wfd = n;
+  c->rfd = -1;
+  c->wfd = n;
+  c->read_eof = 1;
   c->server = 1;
+  c->sender_receiver = RECEIVER;
 
   return c;
 }
@@ -305,10 +369,11 @@ conn_free (conn_t *c)
   close (c->rfd);
   if (c->wfd != c->rfd)
     close (c->wfd);
-  if (!c->server)
+  if (!c->server) {
+    if (pcap_enabled)
+      pcap_forget (c->nfd);
     close (c->nfd);
-  close(infile);
-  close(outfile);
+  }
   cevents_generation++;
 
   /* to help catch errors */
@@ -457,21 +522,49 @@ conn_demux (const struct config_server *cs)
     perror ("UDP recv");
 }
 
-long
-need_timer_in (const struct timespec *last, long timer)
+/* The receive buffer is laid out so that the payload (not the header)
+ * starts on a page boundary, which lets rel_recvpkt hand pkt->data
+ * straight to conn_output_at. */
+static packet_t *
+rx_buffer (void)
+{
+  static packet_t *pkt;
+
+  if (!pkt) {
+    long pagesize = sysconf (_SC_PAGESIZE);
+    size_t hdr = offsetof (packet_t, data);
+    char *base;
+
+    if (pagesize <= 0)
+      pagesize = 4096;
+    if (posix_memalign ((void **) &base, pagesize,
+			pagesize + sizeof (packet_t)))
+      base = xmalloc (pagesize + sizeof (packet_t));
+    pkt = (packet_t *) (base + pagesize - hdr);
+  }
+  return pkt;
+}
+
+/* Milliseconds until rel_timer is due, rounded up, or -1 if nothing is
+   pending and poll can wait for the network or the input alone. */
+static int
+timer_due_in (void)
 {
-  long to;
-  struct timespec ts;
+  uint64_t deadline = rel_next_deadline ();
+  uint64_t now = clock_now ();
 
-  clock_gettime (CLOCK_MONOTONIC, &ts);
-  to = ts.tv_sec - last->tv_sec;
-  if (to > timer / 1000)
-    return 0;
-  to = to * 1000 + (ts.tv_nsec - last->tv_nsec) / 1000000;
-  if (to >= timer)
+  if (!deadline)
+    return -1;
+  if (deadline <= now)
     return 0;
-  return
-    timer - to;
+  return (deadline - now + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC;
+}
+
+void
+conn_wakeups (uint64_t *total, uint64_t *idle)
+{
+  *total = wakeups;
+  *idle = idle_wakeups;
 }
 
 void
@@ -480,6 +573,7 @@ conn_poll (const struct config_common *cc)
   int n, i;
   conn_t *c, *nc;
   static int last_cg;
+  uint64_t deadline, out = pkts_out;
 
   if (last_cg != cevents_generation) {
     conn_mkevents ();
@@ -487,9 +581,15 @@ conn_poll (const struct config_common *cc)
   }
 
   if (cevents[0].fd >= 0)
-    n = poll (cevents, ncevents, need_timer_in (&last_timeout, cc->timer));
+    n = poll (cevents, ncevents, timer_due_in ());
   else
-    n = poll (cevents+1, ncevents-1, need_timer_in (&last_timeout, cc->timer));
+    n = poll (cevents+1, ncevents-1, timer_due_in ());
+  clock_refresh ();
+  wakeups++;
+
+  /* Nothing to do right now, a good time to write out the capture */
+  if (n == 0 && pcap_enabled)
+    pcap_flush ();
 
   for (i = 1; i < ncevents; i++) {
     if (cevents[i].revents & (POLLIN|POLLERR|POLLHUP)) {
@@ -513,15 +613,15 @@ conn_poll (const struct config_common *cc)
 	  rel_destroy (c->rel);
 	}
 	else if (cevents[i].fd == c->nfd && !c->server) {
-	  packet_t pkt;
-	  int len = debug_recv (c->nfd, &pkt, sizeof (pkt), 0, NULL);
+	  packet_t *pkt = rx_buffer ();
+	  int len = debug_recv (c->nfd, pkt, sizeof (*pkt), 0, NULL);
 	  if (len < 0) {
 	    if (errno != EAGAIN)
 	      perror ("recv");
 	  }
 	  else {
-	    rel_recvpkt (c->rel, &pkt, len);
-	    memset (&pkt, 0xc9, len); /* for debugging */
+	    rel_recvpkt (c->rel, pkt, len);
+	    memset (pkt, 0xc9, len); /* for debugging */
 	  }
 	}
       }
@@ -543,16 +643,24 @@ conn_poll (const struct config_common *cc)
     cevents[i].revents = 0;
   }
 
-  if (need_timer_in (&last_timeout, cc->timer) == 0) {
-    rel_timer ();
-    clock_gettime (CLOCK_MONOTONIC, &last_timeout);
+  if (stats_requested) {
+    stats_requested = 0;
+    rel_stats ();
   }
 
+  deadline = rel_next_deadline ();
+  if (deadline && deadline <= clock_now ())
+    rel_timer ();
+  if (n == 0 && pkts_out == out)
+    idle_wakeups++;
+
   for (c = conn_list; c; c = nc) {
     nc = c->next;
     if (c->delete_me && (c->write_err || !c->outq))
       conn_free (c);
   }
+
+  log_flush ();
 }
 
 uint16_t
@@ -812,8 +920,10 @@ debug_recv (int s, packet_t *buf, size_t len, int flags,
     n = recvfrom (s, buf, len, flags, (struct sockaddr *) from, &socklen);
   else
     n = recv (s, buf, len, flags);
-  if (opt_debug)
+  if (LOG_ON (LOG_INFO))
     print_pkt (buf, "recv", n);
+  if (pcap_enabled && n >= 0)
+    pcap_packet (s, 0, from, buf, n);
   return n;
 }
 
@@ -869,14 +979,104 @@ do_server (struct config_server *cs)
   }
 }
 
+/* Runs one connection in stand-alone mode, sending input or receiving
+ * into output, until it is gone.  The process and everything it keeps
+ * outlive it, for the next one. */
+static void
+transfer (const struct config_common *c, struct sockaddr_storage *sl,
+	  const struct sockaddr_storage *sr, const char *input,
+	  const char *output)
+{
+  conn_t *cn = conn_alloc ();
+
+  /* Each connection owns its descriptors, conn_free closes them */
+  if (input) {
+    infile = open (input, O_RDONLY);
+    if (infile < 0) {
+      perror (input);
+      exit (1);
+    }
+    cn->rfd = infile;
+    cn->wfd = dup (STDOUT_FILENO);
+  }
+  else {
+    cn->rfd = dup (STDIN_FILENO);
+    outfile = open (output, O_RDWR|O_CREAT, S_IWRITE|S_IREAD);
+    if (outfile < 0) {
+      perror (output);
+      exit (1);
+    }
+    cn->wfd = outfile;
+  }
+
+  if ((cn->nfd = listen_on (1, sl)) < 0)
+    exit (1);
+  if (connect (cn->nfd, (const struct sockaddr *) sr, addrsize (sr)) < 0) {
+    perror ("connect error");
+    exit (1);
+  }
+  cn->sender_receiver = c->sender_receiver;
+  cn->server = 0;
+  cn->peer = *sr;
+  make_async (cn->rfd);
+  make_async (cn->wfd);
+  make_async (cn->nfd);
+  cn->rel = rel_create (cn, NULL, c);
+
+  conn_mkevents ();
+  while (conn_list)
+    conn_poll (c);
+}
+
+static void
+sigusr1 (int sig)
+{
+  stats_requested = 1;
+}
+
 static void
 usage (void)
 {
   fprintf (stderr,
-	   "usage: %s -s inputfile udp-port [relayer:]udp-port\n"
+	   "usage: %s -s inputfile [-s inputfile ...] udp-port [relayer:]udp-port\n"
            "       %s -r outputfile udp-port [relayer:]udp-port\n"
-           "       -w: RECEIVER's maximum receiving window size, in number of packets\n"
-	   ,progname, progname);
+           "       %s -D -r directory udp-port\n"
+           "       -s: send the files one after another, each a connection of its own\n"
+           "       -D: stay up as a RECEIVER for any number of SENDERs, one after\n"
+           "           another or at once, writing each transfer to a new file in\n"
+           "           directory (named 1, 2, ...)\n"
+           "       -d: print packets and protocol events; repeat for more detail\n"
+           "       -w: RECEIVER's maximum receiving window size, in number of packets;\n"
+           "           after a handshake the SENDER keeps no more than that in flight\n"
+           "       -S: append connection statistics as JSON to this file (default stderr),\n"
+           "           on SIGUSR1 and when the connection ends\n"
+           "       -p: capture every datagram sent and received to this pcap file\n"
+           "       -C: read time from the coarse monotonic clock (cheaper, tick resolution)\n"
+           "       -E: SENDER's reaction to congestion marks: off (default), on (halve\n"
+           "           the window once per window of data) or dctcp (in proportion\n"
+           "           to the fraction of packets marked)\n"
+           "       -A: SENDER's congestion control: aimd (default, loss based), vegas\n"
+           "           or ledbat (both delay based, they keep the bottleneck queue short)\n"
+           "       -T: queueing delay ledbat aims for, in milliseconds (default 5)\n"
+           "       -m: largest payload to send, probed for when above %d and with -e,\n"
+           "           and to accept (default: send %d, accept up to %d)\n"
+           "       -I: SENDER's initial congestion window, in packets, as far as the\n"
+           "           RECEIVER's window allows (default 1)\n"
+           "       -e: SENDER: timestamp packets, for an RTT sample from every ack and\n"
+           "           to undo the window cut of a timeout that proves spurious\n"
+           "       -R: SENDER: take this many duplicate acks for a loss, always\n"
+           "           (default 3, raised as reordering is seen)\n"
+           "       -F: SENDER: follow data with XOR parity packets that rebuild a lost\n"
+           "           packet without a retransmission: off (default), one per n\n"
+           "           packets even on a lossless path, or auto (as many as the loss\n"
+           "           rate measured calls for, none until there is loss)\n"
+           "       -Z: SENDER: compress payloads with zlib, optionally followed by\n"
+           "           :level (default off), sending input that does not compress\n"
+           "           as it is\n"
+           "       The SENDER opens with a handshake when -E, -m, -I, -e, -F or -Z asks for\n"
+           "       more than the base protocol, and goes without if the RECEIVER does not\n"
+           "       answer.\n"
+	   ,progname, progname, progname, PKT_DATA_BASE, PKT_DATA_BASE, PKT_DATA_MAX);
   exit (1);
 }
 
@@ -888,14 +1088,30 @@ main (int argc, char **argv)
     { "window", required_argument, NULL, 'w' },
     { "sender", required_argument, NULL, 's'},
     { "receiver", required_argument, NULL, 'r'},
+    { "stats", required_argument, NULL, 'S'},
+    { "pcap", required_argument, NULL, 'p'},
+    { "coarse-clock", no_argument, NULL, 'C'},
+    { "ecn", required_argument, NULL, 'E'},
+    { "cc", required_argument, NULL, 'A'},
+    { "target", required_argument, NULL, 'T'},
+    { "mss", required_argument, NULL, 'm'},
+    { "initial-window", required_argument, NULL, 'I'},
+    { "timestamps", no_argument, NULL, 'e'},
+    { "dupthresh", required_argument, NULL, 'R'},
+    { "fec", required_argument, NULL, 'F'},
+    { "compress", required_argument, NULL, 'Z'},
+    { "daemon", no_argument, NULL, 'D'},
     { NULL, 0, NULL, 0 }
   };
-  int opt;
+  int opt, i;
   char *local = NULL;
   char *remote = NULL;
-  char *input = NULL;
+  char **inputs = xmalloc (argc * sizeof (*inputs));
+  int ninputs = 0;
   char *output = NULL;
+  int daemon_mode = 0;
   struct config_common c;
+  struct sockaddr_storage sl, sr;
   struct sigaction sa;
 
   /* Ignore SIGPIPE, since we may get a lot of these */
@@ -903,8 +1119,14 @@ main (int argc, char **argv)
   sa.sa_handler = SIG_IGN;
   sigaction (SIGPIPE, &sa, NULL);
 
+  /* SIGUSR1 asks for a statistics dump at the next conn_poll */
+  sa.sa_handler = sigusr1;
+  sigaction (SIGUSR1, &sa, NULL);
+
   memset (&c, 0, sizeof (c));
   c.window = 1;
+  c.target = 5;
+  c.init_window = 1;
   c.sender_receiver = RECEIVER; /* default, it is receiver*/
 
   progname = strrchr (argv[0], '/');
@@ -914,14 +1136,14 @@ main (int argc, char **argv)
     progname = argv[0];
 
 
-  while ((opt = getopt_long (argc, argv, "ds:r:w:", o, NULL)) != -1)
+  while ((opt = getopt_long (argc, argv, "ds:r:w:S:p:CE:A:T:m:I:eR:F:Z:D", o, NULL)) != -1)
     switch (opt) {
     case 'd':
-      opt_debug = 1;
+      opt_debug++;
       break;
     case 's':
       c.sender_receiver = SENDER;
-      input = optarg;
+      inputs[ninputs++] = optarg;
       break;
     case 'r':
       c.sender_receiver = RECEIVER;
@@ -930,67 +1152,111 @@ main (int argc, char **argv)
     case 'w': //receiver's largest receiving window size, the sender does not need this parameter.
       c.window = atoi (optarg);
       break;
+    case 'S':
+      c.stats_file = optarg;
+      break;
+    case 'p':
+      if (pcap_open (optarg) < 0)
+	exit (1);
+      break;
+    case 'C':
+      clock_set_coarse (1);
+      break;
+    case 'E':
+      if (!strcmp (optarg, "off"))
+	c.ecn = ECN_OFF;
+      else if (!strcmp (optarg, "on"))
+	c.ecn = ECN_CLASSIC;
+      else if (!strcmp (optarg, "dctcp"))
+	c.ecn = ECN_DCTCP;
+      else
+	usage ();
+      break;
+    case 'A':
+      if (!strcmp (optarg, "aimd"))
+	c.cc_algo = CC_AIMD;
+      else if (!strcmp (optarg, "vegas"))
+	c.cc_algo = CC_VEGAS;
+      else if (!strcmp (optarg, "ledbat"))
+	c.cc_algo = CC_LEDBAT;
+      else
+	usage ();
+      break;
+    case 'T':
+      c.target = atoi (optarg);
+      break;
+    case 'm':
+      c.mss = atoi (optarg);
+      if (c.mss < PKT_DATA_BASE || c.mss > PKT_DATA_MAX)
+	usage ();
+      break;
+    case 'I':
+      c.init_window = atoi (optarg);
+      break;
+    case 'e':
+      c.timestamps = 1;
+      break;
+    case 'R':
+      c.dupthresh = atoi (optarg);
+      if (c.dupthresh < 1)
+	usage ();
+      break;
+    case 'F':
+      if (!strcmp (optarg, "off"))
+	c.fec = FEC_OFF;
+      else if (!strcmp (optarg, "auto"))
+	c.fec = FEC_AUTO;
+      else if ((c.fec = atoi (optarg)) < 1)
+	usage ();
+      break;
+    case 'Z':
+      if (zip_parse (optarg, &c.zip, &c.zip_level) < 0)
+	usage ();
+      break;
+    case 'D':
+      daemon_mode = 1;
+      break;
     default:
       usage ();
       break;
     }
 
 
-  if(optind + 2 != argc || c.window < 1)
+  if (optind + (daemon_mode ? 1 : 2) != argc || c.window < 1 || c.target < 1
+      || c.init_window < 1 || (daemon_mode && (ninputs || !output)))
     usage ();
+  log_level = LOG_WARN + opt_debug;
+  log_start ();
 
-  c.timer = 10; //wake up rel_timer every 10ms
+  c.timer = 10; //retransmission timeouts are multiples of 10ms
   local = argv[optind];
-  remote = argv[optind+1];
 
+  if (daemon_mode) {
+    struct config_server cs;
+    struct stat sb;
 
-  struct sockaddr_storage sl, sr;
-  conn_t *cn = conn_alloc ();
-  c.single_connection = 1;
-  
-  if(c.sender_receiver == SENDER)
-  {
-    infile = open(input, O_RDONLY);
-    if(infile < 0)
-    {
-      fprintf(stderr, "input file open error\n");
+    if (stat (output, &sb) < 0 || !S_ISDIR (sb.st_mode)) {
+      fprintf (stderr, "%s: not a directory\n", output);
       exit (1);
     }
-    cn->rfd = infile;
-    cn->wfd = STDOUT_FILENO;
-  }
-  else if(c.sender_receiver == RECEIVER)
-  {
-    cn->rfd = STDIN_FILENO;
-    outfile = open(output, O_RDWR|O_CREAT, S_IWRITE|S_IREAD);
-    if(outfile < 0)
-    {
-      fprintf(stderr, "output file open error\n");
+    memset (&cs, 0, sizeof (cs));
+    cs.c = c;
+    cs.dir = output;
+    if (get_address (&sl, 1, 1, AF_INET, local) < 0
+	|| (cs.udp_socket = listen_on (1, &sl)) < 0)
       exit (1);
-    }
-    cn->wfd = outfile;
+    do_server (&cs);
   }
 
-
+  remote = argv[optind+1];
   if (get_address (&sr, 0, 1, AF_INET, remote) < 0
-      || get_address (&sl, 1, 1, sr.ss_family, local) < 0
-      || (cn->nfd = listen_on (1, &sl)) < 0)
-      exit (1);
-  if (connect (cn->nfd, (struct sockaddr *) &sr, addrsize (&sr)) < 0) 
-  {
-    perror ("connect error");
+      || get_address (&sl, 1, 1, sr.ss_family, local) < 0)
     exit (1);
-  }
-  cn->sender_receiver = c.sender_receiver;
-  cn->server = 0;
-  cn->peer = sr;
-  make_async (cn->rfd);
-  make_async (cn->wfd);
-  make_async (cn->nfd);
-  cn->rel = rel_create (cn, NULL, &c);
+  c.single_connection = 1;
 
-  conn_mkevents ();
-  while (conn_list)
-    conn_poll (&c);
+  if (c.sender_receiver == RECEIVER)
+    transfer (&c, &sl, &sr, NULL, output);
+  for (i = 0; i < ninputs; i++)
+    transfer (&c, &sl, &sr, inputs[i], NULL);
   return 0;
 }
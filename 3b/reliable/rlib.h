@@ -1,3 +1,6 @@
+#ifndef RLIB_H
+#define RLIB_H
+
 #if DMALLOC
 #include <dmalloc.h>
 #endif /* DMALLOC */
@@ -73,16 +76,133 @@ struct ack_packet {
   uint32_t rwnd;
 };
 
+/* Every peer takes payloads of PKT_DATA_BASE bytes.  Larger ones, up to
+ * PKT_DATA_MAX (a 9000-byte jumbo frame less IPv6, UDP and packet
+ * headers), are only sent once probes of that size got through: a probe
+ * is a data packet with PKT_PROBE set, seqno 0 and a payload of zeros,
+ * and is answered by an ack packet with PKT_PROBE set, the payload size
+ * probed in the window bits and, in ackno, the largest payload the
+ * answering end accepts.  A peer that predates probing takes a probe for
+ * a duplicate and answers with a plain ack.  Senders probe only with
+ * timestamps (HELLO_TS): the fixed retransmission timeout is sized for
+ * base payloads, and windows of larger ones outlast it. */
+#define PKT_DATA_BASE	1000
+#define PKT_DATA_MAX	8936
+
 struct packet {
   uint16_t cksum;
   uint16_t len;
   uint32_t ackno;
   uint32_t rwnd;
   uint32_t seqno;		/* Only valid if length > 8 */
-  char data[1000];
+  char data[PKT_DATA_MAX];
 };
 typedef struct packet packet_t;
 
+/* The top byte of rwnd carries flags; the window is the low 24 bits.
+ * A relayer that sets PKT_CE must patch cksum to match. */
+#define RWND_MASK	0x00ffffff
+#define PKT_ECT		0x80000000 /* Data: sender reacts to PKT_CE marks */
+#define PKT_CE		0x40000000 /* Data: congestion experienced on the way */
+#define PKT_ECE		0x20000000 /* Ack: the packet acked had PKT_CE set */
+#define PKT_PROBE	0x10000000 /* Payload size probe or its answer */
+#define PKT_HELLO	0x08000000 /* Handshake, see struct hello */
+#define PKT_TS		0x04000000 /* Ends in a struct timestamp */
+#define PKT_FEC		0x02000000 /* Data: parity, see struct fec; ack: it rebuilt
+				      a lost packet */
+#define PKT_ZIP		0x01000000 /* Data: the payload is compressed */
+
+/* A sender that wants more than the base protocol first sends a HELLO:
+ * a data packet with PKT_HELLO set, seqno 0 and a struct hello payload
+ * offering HELLO_* features, its largest payload, its receiving window
+ * and the initial window it would like.  The receiver answers with a
+ * HELLO of its own, carrying the features both ends support, its own
+ * limits and the initial window it allows.  Data waits for the answer.
+ * A peer that predates the handshake acks a HELLO as a duplicate, or
+ * drops it and is given up on after a few tries; either way the
+ * connection goes on with no features and an initial window of 1.  The
+ * offer carries an id the sender draws for each connection, so a
+ * receiver daemon tells a new connection from a resend of the last one;
+ * senders that predate it leave it out.  All fields are in network
+ * byte order. */
+struct hello {
+  uint32_t features;
+  uint32_t mss;			/* Largest payload accepted (sent, in the offer) */
+  uint32_t window;		/* Receiving window, in packets */
+  uint32_t init_window;		/* Initial congestion window, in packets */
+  uint32_t conn_id;		/* The sender's connection id, 0 in the answer */
+};
+#define HELLO_MIN_SIZE	((int) offsetof (struct hello, conn_id))
+#define HELLO_ECN	0x00000001 /* Echoes PKT_CE, so PKT_ECT may be set */
+#define HELLO_TS	0x00000002 /* Takes and echoes timestamps */
+#define HELLO_FEC	0x00000004 /* Rebuilds lost packets from parity */
+#define HELLO_ZLIB	0x00000008 /* Takes payloads compressed with deflate */
+#define HELLO_FULL	0x00000010 /* Data packets but the last are full */
+
+/* With HELLO_FULL agreed, every data packet but the last carries as
+ * much payload as seqno 1 does: the sender holds a short read back
+ * until the rest of the payload or the end of the input arrives.  Seqno
+ * n then starts at byte (n-1) times that size, so a receiver whose
+ * output is a regular file writes each payload in place as it arrives
+ * (conn_output_at).  A sender reading a terminal does not offer it,
+ * since it would hold back what is typed. */
+
+/* With HELLO_TS agreed, packets end in a timestamp trailer, not counted
+ * in the payload and taken off before anything else looks at the
+ * packet: tsval is the sending end's clock in microseconds, tsecr the
+ * tsval of the packet that triggered it, so an ack tells which
+ * transmission of a packet it answers (RFC 7323).  Payloads are made
+ * PKT_TS_SIZE smaller, so data packets keep the size probed. */
+struct timestamp {
+  uint32_t tsval;
+  uint32_t tsecr;		/* 0 if there is nothing to echo */
+};
+#define PKT_TS_SIZE	((int) sizeof (struct timestamp))
+
+/* HELLO_FEC is only offered by a sender given -F; receivers accept it.
+ * With it agreed, the sender follows each group of consecutive
+ * data packets with a parity packet: PKT_FEC set, the seqno of the
+ * first packet of the group, and a payload of a struct fec followed by
+ * the XOR of the group's payloads, each padded with zeros to the
+ * longest.  It rebuilds any one packet of the group that is lost; the
+ * receiver then sets PKT_FEC in the ack, since the loss still tells of
+ * congestion.  Parity packets take no seqno and are never resent or
+ * acked.  Payloads are made PKT_FEC_SIZE smaller, so parity packets
+ * keep the size probed.  Fields are in network byte order. */
+struct fec {
+  uint16_t count;		/* Packets in the group */
+  uint16_t len;			/* XOR of their payload lengths */
+  uint32_t flags;		/* XOR of their PKT_ZIP flags */
+};
+#define PKT_FEC_SIZE	((int) sizeof (struct fec))
+
+/* With HELLO_ZLIB agreed, the sender runs its input through one
+ * compression stream, flushed at the end of every chunk read, and cuts
+ * packets from what comes out; those carry PKT_ZIP.  Input that does
+ * not compress goes out as it is, in packets without PKT_ZIP.  The
+ * receiver puts the stream back together in seqno order and
+ * decompresses it before output.  A packet carries pieces of at most 64
+ * chunks, so it decompresses to at most 64 chunks' worth; the receiver
+ * takes more as a corrupt stream. */
+
+/* Sender reaction to congestion marks (config_common.ecn) */
+#define ECN_OFF		0	/* Not ECN capable, congestion shows as loss */
+#define ECN_CLASSIC	1	/* Halve the window once per window of data */
+#define ECN_DCTCP	2	/* Cut in proportion to the fraction marked */
+
+/* Parity packets sent (config_common.fec), or else packets per group */
+#define FEC_OFF		0	/* None */
+#define FEC_AUTO	-1	/* Groups sized to the loss rate measured */
+
+/* Payload compression (config_common.zip), see zip.c */
+#define ZIP_OFF		0
+#define ZIP_ZLIB	1	/* Deflate */
+
+/* Sender congestion control (config_common.cc_algo) */
+#define CC_AIMD		0	/* Grow until loss, then halve */
+#define CC_VEGAS	1	/* Keep a few packets queued, by RTT */
+#define CC_LEDBAT	2	/* Keep queueing delay near config_common.target */
+
 /* -----------------------------------------------------------------------
 
    Important notes about the library:
@@ -174,9 +294,10 @@ typedef struct packet packet_t;
      point you can send out more Acks to get more data from the remote
      side.
 
-   * The function rel_timer is called periodically, currently at a
-     rate 1/5 of the retransmission interval.  You can use this timer
-     to inspect packets and retransmit packets that have not been
+   * The function rel_timer is called when the time returned by
+     rel_next_deadline has come, and not otherwise, so an idle
+     connection does not wake up at all.  You can use this timer to
+     inspect packets and retransmit packets that have not been
      acknowledged.  Do not retransmit every packet every time the
      timer is fired!  You must keep track of which packets need to be
      retransmitted when.
@@ -185,16 +306,29 @@ typedef struct packet packet_t;
 
 struct config_common {
   int window;			/* # of unacknowledged packets in flight */
-  int timer;			/* How often rel_timer called in milliseconds */
+  int timer;			/* Granularity of timeouts in milliseconds */
   int timeout;			/* Retransmission timeout in milliseconds */
   int single_connection;        /* Exit after first connection failure */
   int sender_receiver;          /* sender or receiver*/
+  char *stats_file;		/* Where rel_stats writes, NULL for stderr */
+  int ecn;			/* ECN_OFF, ECN_CLASSIC or ECN_DCTCP */
+  int cc_algo;			/* CC_AIMD, CC_VEGAS or CC_LEDBAT */
+  int target;			/* CC_LEDBAT queueing delay target, ms */
+  int mss;			/* Largest payload sent or accepted, 0 for
+				   PKT_DATA_BASE sent and PKT_DATA_MAX accepted */
+  int init_window;		/* Initial congestion window asked for, packets */
+  int timestamps;		/* Ask for HELLO_TS */
+  int dupthresh;		/* Fixed duplicate ack threshold, 0 to adapt */
+  int fec;			/* FEC_OFF, FEC_AUTO or data packets per
+				   parity, sent whatever the loss */
+  int zip;			/* ZIP_* the sender compresses with */
+  int zip_level;		/* Its level, 0 for the codec's default */
 };
 
 typedef struct reliable_state rel_t;
 
 extern char *progname;		/* Set to name of program by main */
-extern int opt_debug;		/* When != 0, print packets */
+extern int opt_debug;		/* Number of -d flags, each printing more */
 
 
 #if !DMALLOC
@@ -283,15 +417,35 @@ size_t conn_bufspace (conn_t *c);
  * write. */
 int conn_output (conn_t *c, const void *buf, size_t len);
 
+/* Returns non-zero if the output of c is a regular file that can be
+ * written at arbitrary offsets with conn_output_at. */
+int conn_output_seekable (conn_t *c);
+
+/* Write len bytes of output at byte offset off, without going through
+ * the output queue, so that data can be placed in the file out of
+ * order.  Only valid when conn_output_seekable returns non-zero.
+ * Calling it with len == 0 sends an EOF after truncating the output to
+ * off bytes.  Returns len on success, or -1 if there has been an
+ * error. */
+int conn_output_at (conn_t *c, const void *buf, size_t len, off_t off);
+
 /* Get some input from the reliable side.  You must must then put the
  * data into UDP sockets which you send out with conn_sendpkt.  This
  * function returns the number of bytes received, 0 if there is no
  * data currently available, and -1 on EOF or error. */
 int conn_input (conn_t *c, void *buf, size_t len);
 
+/* Returns non-zero if the input of c is a terminal, where a short read
+ * may be all the input there is until someone types more. */
+int conn_input_interactive (conn_t *c);
+
 /* Deallocate a connection */
 void conn_destroy (conn_t *c);
 
+/* Number of times the event loop has woken up, and how many of those
+ * were timeouts that sent nothing. */
+void conn_wakeups (uint64_t *total, uint64_t *idle);
+
 /* Functions you must provide (in reliable.c). */
 
 rel_t *rel_create (conn_t *, const struct sockaddr_storage *,
@@ -308,7 +462,10 @@ void rel_demux (const struct config_common *cc,
 /* Notification handlers */
 void rel_read (rel_t *);    /* Invoked when you can call conn_input */
 void rel_output (rel_t *);  /* Invoked when some output drained */
-void rel_timer (void); /* Invoked roughly each timer/5 milliseconds */
+void rel_timer (void); /* Invoked once rel_next_deadline has passed */
+uint64_t rel_next_deadline (void); /* clock_now time rel_timer is next due,
+				      0 if nothing is pending */
+void rel_stats (void); /* Invoked on SIGUSR1 to dump connection statistics */
 
 
 
@@ -349,3 +506,5 @@ int connect_to (int dgram, const struct sockaddr_storage *ss);
 #if NEED_CLOCK_GETTIME
 int clock_gettime (int, struct timespec *);
 #endif /* NEED_CLOCK_GETTIME */
+
+#endif /* RLIB_H */
@@ -0,0 +1,762 @@
+/* -----------------------------------------------------------------------
+
+   Discrete-event network simulator.
+
+   Runs a sender and a receiver from reliable.c in one process, on a
+   virtual clock, over a pair of simulated links.  It replaces rlib.c:
+   the conn_* functions below hand packets to the links and generate
+   and check the transferred data in memory, and nothing ever sleeps,
+   so a transfer that takes minutes through the relayer takes well
+   under a second here.  Every random choice comes from one generator
+   seeded with -s, so a run can be repeated exactly.
+
+   Each link direction has a bottleneck of -b kbit/s with a drop-tail
+   queue of -q packets, then -D ms of propagation delay.  Packets longer
+   than -M bytes are dropped, and any packet is lost with probability -l
+   before the queue, and after it is held back by up to -O ms with
+   probability -o (reordering) or delivered twice with probability -u
+   (duplication).  With -K, a packet of an ECN capable sender (PKT_ECT)
+   that joins a queue of -K packets or more is marked PKT_CE instead,
+   the way a DCTCP switch marks.  The summary gives each queue's mean
+   and largest length as seen by arriving packets, and the mean time
+   packets waited in it.
+
+   The transfer is checked byte by byte: the sender reads a pattern that
+   depends on the byte offset, which the receiver's output must
+   reproduce.  With -P text the pattern is English-like text, which
+   compresses about as well as logs or source code do, and with -P
+   random it is random bytes, which do not compress at all.  With -r the
+   input comes like a slow pipe's: each read returns at most -r bytes,
+   and the one after it finds nothing until READ_GAP later.  One summary
+   line of key=value pairs goes to stdout, and the exit status is 0 only
+   if the whole file arrived intact.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "rlib.h"
+#include "log.h"
+#include "clock.h"
+#include "zip.h"
+
+struct event {
+  uint64_t at;			/* Virtual time, ns */
+  uint64_t seq;			/* Breaks ties in scheduling order */
+  struct endpoint *to;		/* Destination of the packet */
+  packet_t *pkt;		/* NULL: more input for to (-r) */
+  size_t len;
+};
+
+struct link {
+  uint64_t kbps;		/* Bottleneck rate, 0 for unlimited */
+  uint64_t delay;		/* Propagation delay, ns */
+  int qlimit;			/* Packets the queue holds */
+  size_t mtu;			/* Longer packets are dropped, 0 for no limit */
+  uint64_t busy;		/* When the last queued packet leaves */
+  uint64_t *dep;		/* Departure times of queued packets */
+  int qhead, qlen;
+
+  uint64_t sent, bytes, qdrops, lost, reordered, duplicated, marked, toobig;
+  uint64_t arrivals, qsum, qwait;	/* For the occupancy averages */
+  int qmax;
+};
+
+struct endpoint {
+  conn_t c;			/* First, so a conn_t * converts back */
+  struct endpoint *peer;
+  struct link *link;		/* Outgoing direction */
+  uint64_t in_off;		/* Sender: next byte conn_input returns */
+  uint64_t out_bytes;		/* Receiver: payload bytes written */
+  uint64_t out_end;		/* Receiver: size at EOF */
+  uint64_t bad;			/* Receiver: bytes that did not match */
+  int seekable;
+  uint64_t done;		/* When conn_destroy was called */
+};
+
+char *progname;
+int opt_debug;
+
+static uint64_t now;
+static uint64_t rng;
+static uint64_t size = 1000000;
+static struct event *heap;
+static size_t nheap, heapsize;
+static uint64_t nextseq;
+static uint64_t timer_calls, idle_timer_calls;
+static uint64_t pkts_out;
+
+static double loss, reorder, duplicate;
+static int mark_threshold;
+static uint64_t reorder_max = 5 * NSEC_PER_MSEC;
+
+/* -P, see pattern */
+#define INPUT_PATTERN	0
+#define INPUT_TEXT	1
+#define INPUT_RANDOM	2
+#define TEXT_SIZE	(1 << 20)	/* Text repeats after this many bytes */
+static int input;
+static char *text;
+
+/* -r, see conn_input */
+#define READ_GAP	(NSEC_PER_MSEC / 10)	/* Until input comes after a dry read */
+static size_t read_max;
+static int read_dry;
+
+static uint64_t
+virtual_clock (void)
+{
+  return now;
+}
+
+/* splitmix64 */
+static uint64_t
+rand64 (void)
+{
+  uint64_t z = (rng += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/* Uniform in [0, 1) */
+static double
+rand01 (void)
+{
+  return (rand64 () >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* The byte the sender reads at offset off */
+static inline uint8_t
+pattern (uint64_t off)
+{
+  uint64_t z;
+
+  switch (input) {
+  case INPUT_TEXT:
+    return text[off % TEXT_SIZE];
+  case INPUT_RANDOM:
+    /* splitmix64 of the offset of each 8 bytes */
+    z = ((off >> 3) + 1) * 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return (z ^ (z >> 31)) >> (off & 7) * 8;
+  }
+  return (off * 0x9e3779b1ULL) >> 24;
+}
+
+/* Fills text with TEXT_SIZE bytes of words, drawn from a generator of
+ * its own so that the input does not change with -s */
+static void
+text_init (void)
+{
+  static const char *words[] = {
+    "the", "of", "and", "to", "a", "in", "is", "it", "that", "for",
+    "was", "on", "with", "as", "be", "at", "by", "this", "from", "or",
+    "packet", "window", "sender", "receiver", "ack", "timeout", "data",
+    "connection", "loss", "queue", "delay", "bytes", "sequence", "number",
+    "congestion", "control", "retransmit", "network", "link", "time",
+  };
+  uint64_t s = 42;
+  size_t i = 0, n;
+  const char *w;
+  int line = 0;
+
+  text = xmalloc (TEXT_SIZE);
+  while (i < TEXT_SIZE) {
+    s = s * 6364136223846793005ULL + 1442695040888963407ULL;
+    w = words[(s >> 33) % (sizeof (words) / sizeof (words[0]))];
+    for (n = 0; w[n] && i < TEXT_SIZE; n++)
+      text[i++] = w[n];
+    if (i < TEXT_SIZE)
+      text[i++] = ++line % 12 ? ' ' : '\n';
+  }
+}
+
+static int
+ev_before (const struct event *a, const struct event *b)
+{
+  return a->at < b->at || (a->at == b->at && a->seq < b->seq);
+}
+
+static void
+ev_push (struct event *e)
+{
+  size_t i;
+  if (nheap == heapsize) {
+    heapsize = heapsize ? 2 * heapsize : 1024;
+    heap = realloc (heap, heapsize * sizeof (*heap));
+    if (!heap) {
+      perror ("realloc");
+      exit (1);
+    }
+  }
+  e->seq = nextseq++;
+  for (i = nheap++; i > 0 && ev_before (e, &heap[(i - 1) / 2]); i = (i - 1) / 2)
+    heap[i] = heap[(i - 1) / 2];
+  heap[i] = *e;
+}
+
+static void
+ev_pop (struct event *e)
+{
+  struct event last;
+  size_t i = 0, child;
+
+  *e = heap[0];
+  last = heap[--nheap];
+  while ((child = 2 * i + 1) < nheap) {
+    if (child + 1 < nheap && ev_before (&heap[child + 1], &heap[child]))
+      child++;
+    if (!ev_before (&heap[child], &last))
+      break;
+    heap[i] = heap[child];
+    i = child;
+  }
+  heap[i] = last;
+}
+
+static void
+schedule_packet (struct endpoint *to, const packet_t *pkt, size_t len,
+		 uint64_t at)
+{
+  struct event e;
+  e.at = at;
+  e.to = to;
+  e.pkt = xmalloc (sizeof (*e.pkt));
+  memcpy (e.pkt, pkt, len);
+  e.len = len;
+  ev_push (&e);
+}
+
+static void
+link_init (struct link *l, uint64_t kbps, uint64_t delay, int qlimit,
+	   size_t mtu)
+{
+  memset (l, 0, sizeof (*l));
+  l->kbps = kbps;
+  l->delay = delay;
+  l->qlimit = qlimit;
+  l->mtu = mtu;
+  l->dep = xmalloc (qlimit * sizeof (*l->dep));
+}
+
+/* Sets PKT_CE in pkt and patches the checksum to match (RFC 1624) */
+static void
+mark_ce (packet_t *pkt)
+{
+  uint16_t *w = (uint16_t *) &pkt->rwnd;	/* High half of rwnd */
+  uint16_t old = ntohs (*w), new = old | (PKT_CE >> 16);
+  uint32_t sum = (uint16_t) ~ntohs (pkt->cksum) + (uint16_t) ~old + new;
+
+  sum = (sum & 0xffff) + (sum >> 16);
+  sum = (sum & 0xffff) + (sum >> 16);
+  *w = htons (new);
+  sum = (uint16_t) ~sum;
+  pkt->cksum = htons (sum ? sum : 0xffff);
+}
+
+static void
+link_send (struct link *l, struct endpoint *to, const packet_t *pkt,
+	   size_t len)
+{
+  uint64_t at;
+  packet_t copy;
+
+  if (l->mtu && len > l->mtu) {
+    l->toobig++;
+    return;
+  }
+  if (loss > 0 && rand01 () < loss) {
+    l->lost++;
+    return;
+  }
+
+  /* Forget the packets that have left the queue by now */
+  while (l->qlen && l->dep[l->qhead] <= now) {
+    l->qhead = (l->qhead + 1) % l->qlimit;
+    l->qlen--;
+  }
+  l->arrivals++;
+  l->qsum += l->qlen;
+  if (l->qlen > l->qmax)
+    l->qmax = l->qlen;
+  if (l->qlen == l->qlimit) {
+    l->qdrops++;
+    return;
+  }
+
+  if (l->busy < now)
+    l->busy = now;
+  l->qwait += l->busy - now;
+  if (mark_threshold && l->qlen >= mark_threshold && len > 12
+      && (ntohl (pkt->rwnd) & PKT_ECT)) {
+    memcpy (&copy, pkt, len);
+    mark_ce (&copy);
+    pkt = &copy;
+    l->marked++;
+  }
+  if (l->kbps)
+    l->busy += len * 8 * NSEC_PER_MSEC / l->kbps;
+  l->dep[(l->qhead + l->qlen++) % l->qlimit] = l->busy;
+  l->sent++;
+  l->bytes += len;
+
+  at = l->busy + l->delay;
+  if (reorder > 0 && rand01 () < reorder) {
+    at += rand01 () * reorder_max;
+    l->reordered++;
+  }
+  schedule_packet (to, pkt, len, at);
+  if (duplicate > 0 && rand01 () < duplicate) {
+    schedule_packet (to, pkt, len, at + rand01 () * reorder_max);
+    l->duplicated++;
+  }
+}
+
+static void
+check_output (struct endpoint *e, const void *buf, size_t len, uint64_t off)
+{
+  const uint8_t *p = buf;
+  size_t i;
+  for (i = 0; i < len; i++)
+    if (p[i] != pattern (off + i))
+      e->bad++;
+  e->out_bytes += len;
+}
+
+/* The rlib interface, as seen by reliable.c */
+
+void *
+xmalloc (size_t n)
+{
+  void *p = malloc (n);
+  if (!p) {
+    fprintf (stderr, "%s: out of memory allocating %d bytes\n",
+	     progname, (int) n);
+    abort ();
+  }
+  return p;
+}
+
+uint16_t
+cksum (const void *_data, int len)
+{
+  const uint8_t *data = _data;
+  uint32_t sum;
+
+  for (sum = 0;len >= 2; data += 2, len -= 2)
+    sum += data[0] << 8 | data[1];
+  if (len > 0)
+    sum += data[0] << 8;
+  while (sum > 0xffff)
+    sum = (sum >> 16) + (sum & 0xffff);
+  sum = htons (~sum);
+  return sum ? sum : 0xffff;
+}
+
+conn_t *
+conn_create (rel_t *r, const struct sockaddr_storage *ss)
+{
+  /* There is no server mode in the simulator */
+  return NULL;
+}
+
+int
+addreq (const struct sockaddr_storage *a, const struct sockaddr_storage *b)
+{
+  /* The endpoints have no address, and run one connection */
+  return !memcmp (a, b, sizeof (*a));
+}
+
+unsigned int
+addrhash (const struct sockaddr_storage *ss)
+{
+  return 0;
+}
+
+int
+conn_sendpkt (conn_t *c, const packet_t *pkt, size_t len)
+{
+  struct endpoint *e = (struct endpoint *) c;
+  pkts_out++;
+  link_send (e->link, e->peer, pkt, len);
+  return len;
+}
+
+size_t
+conn_bufspace (conn_t *c)
+{
+  /* Output is consumed as soon as it is written */
+  return 2 * PKT_DATA_MAX;
+}
+
+int
+conn_output (conn_t *c, const void *buf, size_t len)
+{
+  struct endpoint *e = (struct endpoint *) c;
+  if (!len) {
+    c->write_eof = 1;
+    e->out_end = e->out_bytes;
+    return 0;
+  }
+  check_output (e, buf, len, e->out_bytes);
+  return len;
+}
+
+int
+conn_output_seekable (conn_t *c)
+{
+  return ((struct endpoint *) c)->seekable;
+}
+
+int
+conn_output_at (conn_t *c, const void *buf, size_t len, off_t off)
+{
+  struct endpoint *e = (struct endpoint *) c;
+  if (!len) {
+    c->write_eof = 1;
+    e->out_end = off;
+    return 0;
+  }
+  check_output (e, buf, len, off);
+  return len;
+}
+
+int
+conn_input (conn_t *c, void *buf, size_t len)
+{
+  struct endpoint *e = (struct endpoint *) c;
+  uint8_t *p = buf;
+  size_t i;
+
+  if (c->sender_receiver != SENDER || e->in_off == size) {
+    c->read_eof = 1;
+    return -1;
+  }
+  if (len > size - e->in_off)
+    len = size - e->in_off;
+  if (read_max) {
+    if (read_dry) {
+      /* Nothing yet; what rlib's poll does once more arrives */
+      struct event ev;
+      ev.at = now + READ_GAP;
+      ev.to = e;
+      ev.pkt = NULL;
+      ev.len = 0;
+      ev_push (&ev);
+      read_dry = 0;
+      return 0;
+    }
+    if (len > read_max)
+      len = 1 + rand64 () % read_max;
+    read_dry = 1;
+  }
+  for (i = 0; i < len; i++)
+    p[i] = pattern (e->in_off + i);
+  e->in_off += len;
+  return len;
+}
+
+int
+conn_input_interactive (conn_t *c)
+{
+  return 0;
+}
+
+void
+conn_wakeups (uint64_t *total, uint64_t *idle)
+{
+  /* There is no event loop to wake; count the rel_timer calls */
+  *total = timer_calls;
+  *idle = idle_timer_calls;
+}
+
+void
+conn_destroy (conn_t *c)
+{
+  struct endpoint *e = (struct endpoint *) c;
+  c->delete_me = 1;
+  e->done = now;
+}
+
+static void
+usage (void)
+{
+  fprintf (stderr, "usage: %s [-d] [-s seed] [-n bytes] [-w window]"
+	   " [-m payload] [-I init-window] [-e]\n"
+	   "          [-R dupthresh] [-F off|auto|n] [-Z off|codec[:level]]\n"
+	   "          [-P pattern|text|random] [-r read-max] [-b kbps] [-D delay-ms] [-q queue-pkts] [-M mtu]\n"
+	   "          [-l loss]"
+	   " [-o reorder] [-O reorder-ms] [-u duplicate]\n"
+	   "          [-K mark-pkts] [-E off|on|dctcp] [-A aimd|vegas|ledbat]"
+	   " [-T target-ms]\n"
+	   "          [-t limit-s] [-f] [-S statsfile]\n", progname);
+  exit (1);
+}
+
+static void
+print_link (const char *name, const struct link *l)
+{
+  printf (" %s_pkts=%llu %s_bytes=%llu %s_qdrops=%llu %s_lost=%llu"
+	  " %s_reordered=%llu %s_duplicated=%llu %s_marked=%llu %s_toobig=%llu",
+	  name, (unsigned long long) l->sent,
+	  name, (unsigned long long) l->bytes,
+	  name, (unsigned long long) l->qdrops,
+	  name, (unsigned long long) l->lost,
+	  name, (unsigned long long) l->reordered,
+	  name, (unsigned long long) l->duplicated,
+	  name, (unsigned long long) l->marked,
+	  name, (unsigned long long) l->toobig);
+  printf (" %s_qavg=%.2f %s_qmax=%d %s_qdelay_ms=%.3f",
+	  name, l->arrivals ? (double) l->qsum / l->arrivals : 0,
+	  name, l->qmax,
+	  name, l->sent ? l->qwait / 1e6 / l->sent : 0);
+}
+
+int
+main (int argc, char **argv)
+{
+  struct config_common cc;
+  struct endpoint snd, rcv;
+  struct link fwd, rev;
+  struct event e;
+  struct timespec t0, t1;
+  uint64_t seed = 1, kbps = 10000, delay = 10, limit = 600, mtu = 0;
+  int qlimit = 100, seekable = 0;
+  double wall_ms, sim_ms;
+  int ok, opt;
+
+  progname = strrchr (argv[0], '/');
+  progname = progname ? progname + 1 : argv[0];
+
+  memset (&cc, 0, sizeof (cc));
+  cc.window = 1;
+  cc.timer = 10;
+  cc.timeout = 50;
+  cc.target = 5;
+  cc.init_window = 1;
+  cc.single_connection = 1;
+
+  while ((opt = getopt (argc, argv, "ds:n:w:m:I:eR:F:Z:P:r:b:D:q:M:l:o:O:u:K:E:A:T:t:fS:")) != -1)
+    switch (opt) {
+    case 'd':
+      opt_debug++;
+      break;
+    case 's':
+      seed = strtoull (optarg, NULL, 0);
+      break;
+    case 'n':
+      size = strtoull (optarg, NULL, 0);
+      break;
+    case 'w':
+      cc.window = atoi (optarg);
+      break;
+    case 'm':
+      cc.mss = atoi (optarg);
+      if (cc.mss < PKT_DATA_BASE || cc.mss > PKT_DATA_MAX)
+	usage ();
+      break;
+    case 'I':
+      cc.init_window = atoi (optarg);
+      break;
+    case 'e':
+      cc.timestamps = 1;
+      break;
+    case 'R':
+      cc.dupthresh = atoi (optarg);
+      if (cc.dupthresh < 1)
+	usage ();
+      break;
+    case 'F':
+      if (!strcmp (optarg, "off"))
+	cc.fec = FEC_OFF;
+      else if (!strcmp (optarg, "auto"))
+	cc.fec = FEC_AUTO;
+      else if ((cc.fec = atoi (optarg)) < 1)
+	usage ();
+      break;
+    case 'Z':
+      if (zip_parse (optarg, &cc.zip, &cc.zip_level) < 0)
+	usage ();
+      break;
+    case 'P':
+      if (!strcmp (optarg, "pattern"))
+	input = INPUT_PATTERN;
+      else if (!strcmp (optarg, "text"))
+	input = INPUT_TEXT;
+      else if (!strcmp (optarg, "random"))
+	input = INPUT_RANDOM;
+      else
+	usage ();
+      break;
+    case 'r':
+      read_max = strtoull (optarg, NULL, 0);
+      break;
+    case 'b':
+      kbps = strtoull (optarg, NULL, 0);
+      break;
+    case 'D':
+      delay = strtoull (optarg, NULL, 0);
+      break;
+    case 'q':
+      qlimit = atoi (optarg);
+      break;
+    case 'M':
+      mtu = strtoull (optarg, NULL, 0);
+      break;
+    case 'l':
+      loss = atof (optarg);
+      break;
+    case 'o':
+      reorder = atof (optarg);
+      break;
+    case 'O':
+      reorder_max = atof (optarg) * NSEC_PER_MSEC;
+      break;
+    case 'u':
+      duplicate = atof (optarg);
+      break;
+    case 'K':
+      mark_threshold = atoi (optarg);
+      break;
+    case 'E':
+      if (!strcmp (optarg, "off"))
+	cc.ecn = ECN_OFF;
+      else if (!strcmp (optarg, "on"))
+	cc.ecn = ECN_CLASSIC;
+      else if (!strcmp (optarg, "dctcp"))
+	cc.ecn = ECN_DCTCP;
+      else
+	usage ();
+      break;
+    case 'A':
+      if (!strcmp (optarg, "aimd"))
+	cc.cc_algo = CC_AIMD;
+      else if (!strcmp (optarg, "vegas"))
+	cc.cc_algo = CC_VEGAS;
+      else if (!strcmp (optarg, "ledbat"))
+	cc.cc_algo = CC_LEDBAT;
+      else
+	usage ();
+      break;
+    case 'T':
+      cc.target = atoi (optarg);
+      break;
+    case 't':
+      limit = strtoull (optarg, NULL, 0);
+      break;
+    case 'f':
+      seekable = 1;
+      break;
+    case 'S':
+      cc.stats_file = optarg;
+      break;
+    default:
+      usage ();
+    }
+  if (optind != argc || cc.window < 1 || qlimit < 1 || cc.target < 1
+      || cc.init_window < 1)
+    usage ();
+  log_level = LOG_WARN + opt_debug;
+  if (input == INPUT_TEXT)
+    text_init ();
+  rng = seed;
+  clock_set_source (virtual_clock);
+
+  link_init (&fwd, kbps, delay * NSEC_PER_MSEC, qlimit, mtu);
+  link_init (&rev, kbps, delay * NSEC_PER_MSEC, qlimit, mtu);
+
+  memset (&snd, 0, sizeof (snd));
+  memset (&rcv, 0, sizeof (rcv));
+  snd.c.sender_receiver = SENDER;
+  snd.peer = &rcv;
+  snd.link = &fwd;
+  rcv.c.sender_receiver = RECEIVER;
+  rcv.peer = &snd;
+  rcv.link = &rev;
+  rcv.seekable = seekable;
+
+  clock_gettime (CLOCK_MONOTONIC, &t0);
+
+  /* The receiver sends its EOF from rel_create, so the sender has to
+   * exist by then */
+  cc.sender_receiver = SENDER;
+  snd.c.rel = rel_create (&snd.c, NULL, &cc);
+  cc.sender_receiver = RECEIVER;
+  rcv.c.rel = rel_create (&rcv.c, NULL, &cc);
+  rel_read (snd.c.rel);
+
+  for (;;) {
+    uint64_t deadline = rel_next_deadline ();
+
+    if (snd.c.delete_me && rcv.c.delete_me)
+      break;
+    if (!nheap && !deadline) {
+      log_error ("%s: nothing in flight and nothing pending\n", progname);
+      break;
+    }
+    if (deadline && (!nheap || deadline <= heap[0].at)) {
+      /* rel_timer goes before packets arriving at the same instant */
+      now = deadline;
+      e.to = NULL;		/* No destination: a timer event */
+    }
+    else {
+      ev_pop (&e);
+      now = e.at;
+    }
+    if (now > limit * NSEC_PER_SEC) {
+      log_error ("%s: no progress after %llu s of simulated time\n",
+		 progname, (unsigned long long) limit);
+      break;
+    }
+    clock_refresh ();
+
+    if (!e.to) {
+      uint64_t out = pkts_out;
+      rel_timer ();
+      timer_calls++;
+      if (pkts_out == out)
+	idle_timer_calls++;
+      log_flush ();
+    }
+    else if (!e.pkt) {
+      if (!e.to->c.delete_me)
+	rel_read (e.to->c.rel);
+    }
+    else {
+      if (e.to->c.delete_me) {
+	/* What rlib does on an ICMP port unreachable */
+	if (!e.to->peer->c.delete_me)
+	  rel_destroy (e.to->peer->c.rel);
+      }
+      else
+	rel_recvpkt (e.to->c.rel, e.pkt, e.len);
+      free (e.pkt);
+    }
+  }
+  log_flush ();
+
+  clock_gettime (CLOCK_MONOTONIC, &t1);
+  wall_ms = (t1.tv_sec - t0.tv_sec) * 1000.0 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+  sim_ms = (rcv.done ? rcv.done : now) / 1e6;
+  ok = rcv.c.write_eof && !rcv.bad && rcv.out_end == size
+    && rcv.out_bytes == size;
+
+  printf ("seed=%llu size=%llu ok=%d sim_ms=%.3f wall_ms=%.3f speedup=%.0f"
+	  " goodput_kbps=%.1f",
+	  (unsigned long long) seed, (unsigned long long) size, ok,
+	  sim_ms, wall_ms, wall_ms > 0 ? sim_ms / wall_ms : 0,
+	  sim_ms > 0 ? rcv.out_bytes * 8 / sim_ms : 0);
+  print_link ("fwd", &fwd);
+  print_link ("rev", &rev);
+  printf ("\n");
+  return !ok;
+}
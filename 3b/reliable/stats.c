@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "stats.h"
+
+void stats_hist_add(uint32_t *hist, uint64_t v){
+	int b = v > 1 ? 63 - __builtin_clzll(v) : 0;
+	if(b >= STATS_HIST_BUCKETS){
+		b = STATS_HIST_BUCKETS - 1;
+	}
+	hist[b]++;
+}
+
+void stats_write_hist(FILE *f, const uint32_t *hist){
+	int last = STATS_HIST_BUCKETS - 1;
+	int i;
+	while(last >= 0 && hist[last] == 0){
+		last--;
+	}
+	fputc('[', f);
+	for(i = 0; i <= last; i++){
+		fprintf(f, i ? ",%" PRIu32 : "%" PRIu32, hist[i]);
+	}
+	fputc(']', f);
+}
+
+void stats_write_counters(FILE *f, const stats_t *s){
+	fprintf(f, "\"pkts_sent\":%" PRIu64 ",\"bytes_sent\":%" PRIu64
+		",\"retransmits\":%" PRIu64 ",\"acks_rcvd\":%" PRIu64
+		",\"dup_acks\":%" PRIu64 ",\"timeouts\":%" PRIu64
+		",\"bytes_acked\":%" PRIu64 ",\"ece_rcvd\":%" PRIu64
+		",\"ecn_cuts\":%" PRIu64 ",\"probes_sent\":%" PRIu64
+		",\"spurious_rtos\":%" PRIu64
+		",\"rack_losses\":%" PRIu64 ",\"tlp_probes\":%" PRIu64
+		",\"reorder_undos\":%" PRIu64 ",\"fec_sent\":%" PRIu64
+		",\"fec_repaired\":%" PRIu64 ",\"zip_bytes_in\":%" PRIu64
+		",\"zip_bytes_out\":%" PRIu64 ",\"zip_bypassed\":%" PRIu64,
+		s->pkts_sent, s->bytes_sent, s->retransmits, s->acks_rcvd,
+		s->dup_acks, s->timeouts, s->bytes_acked, s->ece_rcvd, s->ecn_cuts,
+		s->probes_sent, s->spurious_rtos, s->rack_losses, s->tlp_probes,
+		s->reorder_undos, s->fec_sent, s->fec_repaired, s->zip_bytes_in,
+		s->zip_bytes_out, s->zip_bypassed);
+	fprintf(f, ",\"pkts_rcvd\":%" PRIu64 ",\"dup_pkts\":%" PRIu64
+		",\"bytes_delivered\":%" PRIu64 ",\"acks_sent\":%" PRIu64
+		",\"acks_piggybacked\":%" PRIu64 ",\"ce_rcvd\":%" PRIu64
+		",\"fec_rcvd\":%" PRIu64 ",\"fec_rebuilt\":%" PRIu64,
+		s->pkts_rcvd, s->dup_pkts, s->bytes_delivered, s->acks_sent,
+		s->acks_piggybacked, s->ce_rcvd, s->fec_rcvd, s->fec_rebuilt);
+	fputs(",\"cwnd_hist\":", f);
+	stats_write_hist(f, s->cwnd_hist);
+	fputs(",\"ssthresh_hist\":", f);
+	stats_write_hist(f, s->ssthresh_hist);
+	fputs(",\"srtt_hist_us\":", f);
+	stats_write_hist(f, s->srtt_hist);
+}
@@ -0,0 +1,60 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ Per-connection counters.  Histograms are log2 buckets: bucket 0 counts
+ values 0 and 1, bucket i counts values in [2^i, 2^(i+1)).
+ */
+#define STATS_HIST_BUCKETS	32
+
+typedef struct stats{
+	//Sending side
+	uint64_t pkts_sent;		/* Data packets, retransmissions included */
+	uint64_t bytes_sent;		/* Payload bytes, retransmissions included */
+	uint64_t retransmits;
+	uint64_t acks_rcvd;
+	uint64_t dup_acks;
+	uint64_t timeouts;		/* Retransmissions fired by rel_timer */
+	uint64_t bytes_acked;		/* Payload bytes cumulatively acked */
+	uint64_t ece_rcvd;		/* Acks echoing a congestion mark */
+	uint64_t ecn_cuts;		/* Window reductions for marks */
+	uint64_t probes_sent;		/* Payload size probes */
+	uint64_t spurious_rtos;		/* Timeouts undone, their packet was not lost */
+	uint64_t rack_losses;		/* Retransmissions RACK found due */
+	uint64_t tlp_probes;		/* Tail loss probes */
+	uint64_t reorder_undos;		/* Loss cuts undone, the hole was only reordered */
+	uint64_t fec_sent;		/* Parity packets */
+	uint64_t fec_repaired;		/* Acks telling a loss was rebuilt from parity */
+	uint64_t zip_bytes_in;		/* Input bytes compressed */
+	uint64_t zip_bytes_out;		/* What they compressed to */
+	uint64_t zip_bypassed;		/* Input bytes sent as they are, not compressing */
+
+	//Receiving side
+	uint64_t pkts_rcvd;		/* Data packets that passed the checksum */
+	uint64_t dup_pkts;		/* Data packets that had already arrived */
+	uint64_t bytes_delivered;	/* Payload bytes handed to the output */
+	uint64_t acks_sent;		/* On their own, not carried by data */
+	uint64_t acks_piggybacked;	/* Carried by data instead */
+	uint64_t ce_rcvd;		/* Data packets marked congestion experienced */
+	uint64_t fec_rcvd;		/* Parity packets */
+	uint64_t fec_rebuilt;		/* Lost data packets rebuilt from parity */
+
+	uint32_t cwnd_hist[STATS_HIST_BUCKETS];		/* Sampled on every ack */
+	uint32_t ssthresh_hist[STATS_HIST_BUCKETS];	/* Sampled on every ack */
+	uint32_t srtt_hist[STATS_HIST_BUCKETS];		/* Microseconds, on every RTT sample */
+}stats_t;
+
+/* Counts v in the log2 bucket it falls in. */
+void stats_hist_add(uint32_t *hist, uint64_t v);
+
+/* Writes hist as a JSON array, without trailing empty buckets. */
+void stats_write_hist(FILE *f, const uint32_t *hist);
+
+/* Writes the counters of s as JSON members (without braces), so the
+ * caller can add its own members before and after. */
+void stats_write_counters(FILE *f, const stats_t *s);
+
+#endif /* STATS_H */
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <zlib.h>
+
+#include "rlib.h"
+#include "zip.h"
+
+#define ZIP_ROOM	16384	/* Decompressed output room made before each step */
+
+struct zip_stream{
+	int codec;
+	bool compress;
+	z_stream zs;
+};
+
+/*
+ * Makes room for at least ZIP_ROOM more bytes after the first len of
+ * *out.
+ */
+static void grow(char **out, size_t *cap, size_t len){
+	char *p;
+	size_t n = *cap ? *cap : ZIP_ROOM;
+	if(*cap - len >= ZIP_ROOM){
+		return;
+	}
+	while(n - len < ZIP_ROOM){
+		n *= 2;
+	}
+	p = xmalloc(n);
+	if(len){
+		memcpy(p, *out, len);
+	}
+	free(*out);
+	*out = p;
+	*cap = n;
+}
+
+bool zip_supported(int codec){
+	switch(codec){
+	case ZIP_ZLIB:
+		return true;
+	default:
+		return false;
+	}
+}
+
+int zip_parse(const char *arg, int *codec, int *level){
+	static const char *names[] = { "off", "zlib" };
+	const char *colon = strchr(arg, ':');
+	size_t len = colon ? (size_t)(colon - arg) : strlen(arg);
+	char *end;
+	int i;
+	*level = 0;
+	for(i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++){
+		if(strlen(names[i]) == len && !strncmp(arg, names[i], len)){
+			break;
+		}
+	}
+	if(i == ZIP_OFF && !colon){
+		*codec = ZIP_OFF;
+		return 0;
+	}
+	if(!zip_supported(i)){
+		return -1;
+	}
+	if(colon){
+		*level = strtol(colon + 1, &end, 10);
+		if(end == colon + 1 || *end){
+			return -1;
+		}
+	}
+	*codec = i;
+	return 0;
+}
+
+zip_stream *zip_new(int codec, int level, bool compress){
+	zip_stream *z;
+	int ok = 0;
+
+	if(!zip_supported(codec)){
+		return NULL;
+	}
+	z = xmalloc(sizeof(*z));
+	memset(z, 0, sizeof(*z));
+	z->codec = codec;
+	z->compress = compress;
+	switch(codec){
+	case ZIP_ZLIB:
+		if(compress){
+			ok = deflateInit(&z->zs, level ? level : Z_DEFAULT_COMPRESSION) == Z_OK;
+		} else {
+			ok = inflateInit(&z->zs) == Z_OK;
+		}
+		break;
+	}
+	if(!ok){
+		zip_free(z);
+		return NULL;
+	}
+	return z;
+}
+
+void zip_free(zip_stream *z){
+	if(!z){
+		return;
+	}
+	switch(z->codec){
+	case ZIP_ZLIB:
+		if(z->compress){
+			deflateEnd(&z->zs);
+		} else {
+			inflateEnd(&z->zs);
+		}
+		break;
+	}
+	free(z);
+}
+
+size_t zip_bound(const zip_stream *z, size_t n){
+	//deflateBound is for Z_FINISH, a sync flush adds an empty block
+	return compressBound(n) + 16;
+}
+
+int zip_compress(zip_stream *z, const char *in, int n, char *out){
+	size_t cap = zip_bound(z, n);
+
+	z->zs.next_in = (Bytef *)in;
+	z->zs.avail_in = n;
+	z->zs.next_out = (Bytef *)out;
+	z->zs.avail_out = cap;
+	if(deflate(&z->zs, Z_SYNC_FLUSH) != Z_OK || z->zs.avail_in || !z->zs.avail_out){
+		return -1;
+	}
+	return cap - z->zs.avail_out;
+}
+
+int zip_decompress(zip_stream *z, const char *in, int n, char **out, size_t *cap,
+		size_t max){
+	size_t len = 0;
+	int r;
+
+	z->zs.next_in = (Bytef *)in;
+	z->zs.avail_in = n;
+	do{
+		grow(out, cap, len);
+		z->zs.next_out = (Bytef *)*out + len;
+		z->zs.avail_out = *cap - len;
+		r = inflate(&z->zs, Z_SYNC_FLUSH);
+		if(r != Z_OK && r != Z_BUF_ERROR){
+			return -1;
+		}
+		len = *cap - z->zs.avail_out;
+		if(len > max){
+			//a bomb, or not what the sender compressed
+			return -1;
+		}
+	}while(z->zs.avail_in || !z->zs.avail_out);
+	return len;
+}
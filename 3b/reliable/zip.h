@@ -0,0 +1,44 @@
+#ifndef ZIP_H
+#define ZIP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ One direction of a connection's compression stream, see PKT_ZIP in
+ rlib.h.  Every zip_compress call flushes, so what it returns decodes
+ to all of its input and nothing waits inside the compressor, while the
+ stream goes on from call to call and later chunks still refer back to
+ earlier ones.  Codecs are the ZIP_* of rlib.h.
+ */
+typedef struct zip_stream zip_stream;
+
+/* Returns true if codec was built in. */
+bool zip_supported(int codec);
+
+/* Parses a -Z argument, off or codec[:level] with codec zlib, into
+ * *codec and *level.  Returns -1 if it names no codec that was built in
+ * or the level is not a number. */
+int zip_parse(const char *arg, int *codec, int *level);
+
+/* Returns a new compressing or decompressing stream, level being the
+ * compression level or 0 for the codec's default.  NULL if codec is not
+ * built in or the codec fails to set up. */
+zip_stream *zip_new(int codec, int level, bool compress);
+void zip_free(zip_stream *z);
+
+/* The most zip_compress may make of n bytes. */
+size_t zip_bound(const zip_stream *z, size_t n);
+
+/* Compresses the n bytes of in into out, which must have room for
+ * zip_bound(n), and flushes.  Returns the length written, -1 on error. */
+int zip_compress(zip_stream *z, const char *in, int n, char *out);
+
+/* Decompresses the n bytes of in, the next piece of the stream, into
+ * *out, of *cap bytes, which is grown as needed.  Returns the length of
+ * what came out, -1 if the stream is corrupt or more than max bytes
+ * would come out. */
+int zip_decompress(zip_stream *z, const char *in, int n, char **out, size_t *cap,
+		size_t max);
+
+#endif /* ZIP_H */